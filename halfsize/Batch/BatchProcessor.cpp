@@ -0,0 +1,363 @@
+#include "BatchProcessor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "../TGAProcessing/TGAProcessing.h"
+
+
+BatchProcessor::BatchProcessor(std::shared_ptr<ThreadPool> sharedThreadPool)
+    : threadPool(sharedThreadPool ? sharedThreadPool : std::make_shared<ThreadPool>()), rleOutput(false),
+      linearLight(false), parallelRead(false), directIo(false), collectStats(false), pipelined(false)
+{
+}
+
+BatchProcessor::~BatchProcessor()
+{
+}
+
+void BatchProcessor::SetRleOutput(bool enabled)
+{
+    rleOutput = enabled;
+}
+
+void BatchProcessor::SetLinearLight(bool enabled)
+{
+    linearLight = enabled;
+}
+
+void BatchProcessor::SetParallelRead(bool enabled, bool direct)
+{
+    parallelRead = enabled;
+    directIo = direct;
+}
+
+void BatchProcessor::SetStatsEnabled(bool enabled)
+{
+    collectStats = enabled;
+}
+
+void BatchProcessor::SetPipelined(bool enabled)
+{
+    pipelined = enabled;
+}
+
+void BatchProcessor::SetOutputCache(std::shared_ptr<OutputCache> cache)
+{
+    outputCache = cache;
+}
+
+/**
+Thread running one stage of the pipeline, one step at a time
+*/
+class StageThread
+{
+public:
+    StageThread()
+        : hasTask(false), stopping(false), thread(&StageThread::Loop, this)
+    {
+    }
+
+    ~StageThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        thread.join();
+    }
+
+    StageThread(const StageThread&) = delete;
+    StageThread& operator=(const StageThread&) = delete;
+
+    void Start(std::function<void()> stepTask)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = std::move(stepTask);
+            hasTask = true;
+        }
+        condition.notify_all();
+    }
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return !hasTask; });
+    }
+
+private:
+    std::mutex              mutex;
+    std::condition_variable condition;
+    std::function<void()>   task;
+    bool                    hasTask;
+    bool                    stopping;
+    std::thread             thread;     // last, it starts once the members above are set
+
+    void Loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            condition.wait(lock, [this]() { return hasTask || stopping; });
+            if (!hasTask)
+                return;
+
+            lock.unlock();
+            task();
+            lock.lock();
+            hasTask = false;
+            condition.notify_all();
+        }
+    }
+};
+
+static t_batchjob make_job(const std::string& inputFileName, const std::string& outputFileName)
+{
+    t_batchjob job;
+    job.inputFileName = inputFileName;
+    job.outputFileName = outputFileName;
+    job.status = FILE_OK;
+    job.inputBytes = 0;
+    job.seconds = 0.0;
+    job.stats = t_tgastats();
+    return job;
+}
+
+static std::string trim(const std::string& text)
+{
+    const size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+        return std::string();
+    const size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+static bool has_tga_extension(const std::string& fileName)
+{
+    if (fileName.size() < 4)
+        return false;
+
+    std::string extension = fileName.substr(fileName.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](char c) { return static_cast<char>((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c); });
+    return extension == ".tga";
+}
+
+static size_t file_size(const std::string& fileName)
+{
+    std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return 0;
+    return static_cast<size_t>(file.tellg());
+}
+
+bool BatchProcessor::ReadListFile(const std::string& listFileName, std::vector<t_batchjob>& jobs)
+{
+    std::ifstream listFile(listFileName);
+    if (!listFile.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(listFile, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t separator = line.find('\t');
+        if (separator == std::string::npos)
+            separator = line.find(' ');
+        if (separator == std::string::npos)
+            return false;
+
+        const std::string outputFileName = trim(line.substr(separator + 1));
+        if (outputFileName.empty())
+            return false;
+
+        jobs.push_back(make_job(trim(line.substr(0, separator)), outputFileName));
+    }
+    return true;
+}
+
+bool BatchProcessor::ListDirectory(const std::string& inputDirectory, const std::string& outputDirectory,
+    std::vector<t_batchjob>& jobs)
+{
+    std::vector<std::string> fileNames;
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE findHandle = FindFirstFileA((inputDirectory + "\\*").c_str(), &findData);
+    if (findHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    do {
+        if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 && has_tga_extension(findData.cFileName))
+            fileNames.push_back(findData.cFileName);
+    } while (FindNextFileA(findHandle, &findData));
+    FindClose(findHandle);
+    const char separator = '\\';
+#else
+    DIR* directory = opendir(inputDirectory.c_str());
+    if (directory == nullptr)
+        return false;
+
+    while (dirent* entry = readdir(directory)) {
+        const std::string fileName(entry->d_name);
+        struct stat fileInfo;
+        if (has_tga_extension(fileName) && stat((inputDirectory + "/" + fileName).c_str(), &fileInfo) == 0 &&
+            S_ISREG(fileInfo.st_mode))
+            fileNames.push_back(fileName);
+    }
+    closedir(directory);
+    const char separator = '/';
+#endif
+
+    std::sort(fileNames.begin(), fileNames.end());
+    for (const std::string& fileName : fileNames) {
+        jobs.push_back(make_job(inputDirectory + separator + fileName, outputDirectory + separator + fileName));
+    }
+    return true;
+}
+
+double BatchProcessor::Run(std::vector<t_batchjob>& jobs, float scaleFactor, resizeMethod interpolationMethod)
+{
+    if (pipelined)
+        return RunPipelined(jobs, scaleFactor, interpolationMethod);
+
+    const auto batchStart = std::chrono::steady_clock::now();
+
+    // Largest images are queued first so they are not left for the end of the batch
+    std::vector<size_t> order(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        jobs[i].inputBytes = file_size(jobs[i].inputFileName);
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&jobs](size_t a, size_t b) { return jobs[a].inputBytes > jobs[b].inputBytes; });
+
+    // one file per task, the row bands of each image are stolen by idle threads
+    threadPool->ParallelFor(static_cast<int>(jobs.size()), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            t_batchjob& job = jobs[order[i]];
+            const auto start = std::chrono::steady_clock::now();
+
+            std::unique_ptr<TGAProcessing> tgaImageProcessing = AcquireInstance();
+            job.status = tgaImageProcessing->LoadImage(job.inputFileName);
+            if (FILE_OK == job.status) {
+                job.status = tgaImageProcessing->ResizeImageToFile(job.outputFileName, scaleFactor, interpolationMethod);
+            }
+            job.stats = tgaImageProcessing->GetStats();
+            ReleaseInstance(std::move(tgaImageProcessing));
+
+            job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    });
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+}
+
+std::unique_ptr<TGAProcessing> BatchProcessor::AcquireInstance()
+{
+    std::unique_ptr<TGAProcessing> instance;
+    {
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        if (!idleInstances.empty()) {
+            instance = std::move(idleInstances.back());
+            idleInstances.pop_back();
+        }
+    }
+
+    // a thread waiting on the bands of its image may pick up another file, which then needs an instance too
+    if (!instance) {
+        instance = std::make_unique<TGAProcessing>(threadPool);
+    }
+
+    // the settings may have changed since the last batch
+    instance->SetRleOutput(rleOutput);
+    instance->SetLinearLight(linearLight);
+    instance->SetParallelRead(parallelRead);
+    instance->SetDirectIo(directIo);
+    instance->SetStatsEnabled(collectStats);
+    instance->SetOutputCache(outputCache);
+    return instance;
+}
+
+void BatchProcessor::ReleaseInstance(std::unique_ptr<TGAProcessing> instance)
+{
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    idleInstances.push_back(std::move(instance));
+}
+
+double BatchProcessor::RunPipelined(std::vector<t_batchjob>& jobs, float scaleFactor, resizeMethod interpolationMethod)
+{
+    const auto batchStart = std::chrono::steady_clock::now();
+
+    // image i uses instance i % PIPELINE_STAGES from its load to its save
+    std::unique_ptr<TGAProcessing> stages[PIPELINE_STAGES];
+    for (std::unique_ptr<TGAProcessing>& stage : stages) {
+        stage = std::make_unique<TGAProcessing>(threadPool);
+        stage->SetRleOutput(rleOutput);
+        stage->SetLinearLight(linearLight);
+        stage->SetParallelRead(parallelRead);
+        stage->SetDirectIo(directIo);
+        stage->SetStatsEnabled(collectStats);
+        stage->SetOutputCache(outputCache);
+        // the reader reads the mapped pixels, otherwise the resize would fault them in
+        stage->SetPrefetch(true);
+    }
+    std::vector<std::chrono::steady_clock::time_point> starts(jobs.size());
+
+    StageThread reader;
+    StageThread writer;
+
+    // step s: load image s, resize image s - 1 and save image s - 2, all three at once
+    const size_t jobCount = jobs.size();
+    for (size_t step = 0; step < jobCount + PIPELINE_STAGES - 1; step++) {
+        if (step < jobCount) {
+            const size_t load = step;
+            reader.Start([&, load]() {
+                t_batchjob& job = jobs[load];
+                starts[load] = std::chrono::steady_clock::now();
+                job.inputBytes = file_size(job.inputFileName);
+                job.status = stages[load % PIPELINE_STAGES]->LoadImage(job.inputFileName);
+            });
+        }
+
+        if (step >= 2 && step - 2 < jobCount) {
+            const size_t save = step - 2;
+            writer.Start([&, save]() {
+                t_batchjob& job = jobs[save];
+                TGAProcessing& stage = *stages[save % PIPELINE_STAGES];
+                if (FILE_OK == job.status) {
+                    job.status = stage.SaveImage(job.outputFileName);
+                }
+                job.stats = stage.GetStats();
+                job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - starts[save]).count();
+            });
+        }
+
+        // the calling thread resizes, the bands run on the pool
+        if (step >= 1 && step - 1 < jobCount && FILE_OK == jobs[step - 1].status) {
+            stages[(step - 1) % PIPELINE_STAGES]->ResizeImage(scaleFactor, interpolationMethod);
+        }
+
+        reader.Wait();
+        writer.Wait();
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+}
@@ -0,0 +1,141 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Common/OutputCache.h"
+#include "../Common/Stats.h"
+#include "../Common/Utilities.h"
+#include "../ThreadPool/ThreadPool.h"
+
+#define PIPELINE_STAGES     3       // images in flight in pipelined mode: loading, resizing and saving
+
+class TGAProcessing;
+
+
+/**
+One image of a batch
+*/
+typedef struct
+{
+    std::string inputFileName;
+    std::string outputFileName;
+
+    fileStatus  status;
+    size_t      inputBytes;     // size of the input file
+    double      seconds;        // load + resize + save time
+    t_tgastats  stats;          // per-stage stats, when enabled
+} t_batchjob;
+
+
+/**
+Resizes many TGA files in one process
+All images share one work-stealing ThreadPool: every file is a task and the row bands of each image
+are tasks too, so threads that finish the small images help with the bands of the large ones.
+Each file in flight takes an idle TGAProcessing and gives it back when it is saved, so the buffers are
+sized by the first images and reused by the next ones and by later batches.
+*/
+class BatchProcessor
+{
+public:
+    /**
+    * @param sharedThreadPool - pool running the files and their row bands
+    */
+    explicit BatchProcessor(std::shared_ptr<ThreadPool> sharedThreadPool);
+    ~BatchProcessor();
+
+    BatchProcessor(const BatchProcessor&) = delete;
+    BatchProcessor& operator=(const BatchProcessor&) = delete;
+
+    /**
+    * Reads a list file, one "input.tga output.tga" pair per line (tab separated when the paths hold spaces)
+    * Empty lines and lines starting with '#' are skipped
+    *
+    * @param listFileName - path of the list file
+    * @param jobs         - jobs appended to
+    * @return false if the list file cannot be opened or a line has no output file
+    */
+    static bool ReadListFile(const std::string& listFileName, std::vector<t_batchjob>& jobs);
+
+    /**
+    * Lists the .tga files of a directory, each one is written under the same name to outputDirectory
+    *
+    * @param inputDirectory  - directory holding the original images
+    * @param outputDirectory - existing directory for the resized images
+    * @param jobs            - jobs appended to
+    * @return false if the input directory cannot be read
+    */
+    static bool ListDirectory(const std::string& inputDirectory, const std::string& outputDirectory,
+        std::vector<t_batchjob>& jobs);
+
+    /**
+    * Resizes every job and fills in its status, input size and time
+    *
+    * @param jobs                - images to resize
+    * @param scaleFactor         - resizing scale factor ( > 1 shrink, < 1 enlarge)
+    * @param interpolationMethod - resizing method
+    * @return wall time of the whole batch in seconds
+    */
+    double Run(std::vector<t_batchjob>& jobs, float scaleFactor, resizeMethod interpolationMethod);
+
+    /**
+    * Writes every resized image run-length encoded, off by default
+    */
+    void SetRleOutput(bool enabled);
+
+    /**
+    * Filters every image in linear light with premultiplied alpha, off by default
+    */
+    void SetLinearLight(bool enabled);
+
+    /**
+    * Reads every image with parallel positional reads, optionally bypassing the page cache, off by default
+    * See TGAProcessing::SetParallelRead() and SetDirectIo()
+    */
+    void SetParallelRead(bool enabled, bool directIo);
+
+    /**
+    * Fills in the per-stage stats of every job, off by default
+    */
+    void SetStatsEnabled(bool enabled);
+
+    /**
+    * Sets the output cache shared by every image, none by default
+    * Images found in it are linked to their output instead of resized
+    */
+    void SetOutputCache(std::shared_ptr<OutputCache> cache);
+
+    /**
+    * Runs the jobs in list order as a pipeline, off by default
+    * A reader thread loads image N + 1 and a writer thread saves image N - 1 while image N is resized on the
+    * pool, so each image takes about max(read, resize, write) instead of their sum. Each image in flight has
+    * its own TGAProcessing, the PIPELINE_STAGES instances and their buffers are reused round robin.
+    */
+    void SetPipelined(bool enabled);
+
+private:
+    std::shared_ptr<ThreadPool> threadPool;
+    bool rleOutput;
+    bool linearLight;
+    bool parallelRead;
+    bool directIo;
+    bool collectStats;
+    bool pipelined;
+    std::shared_ptr<OutputCache> outputCache;
+
+    // Instances of Run() not working on a file, about one per pool thread once the first batch ran
+    std::mutex instanceMutex;
+    std::vector<std::unique_ptr<TGAProcessing>> idleInstances;
+
+    // An idle instance, or a new one when all are busy, configured with the current settings
+    std::unique_ptr<TGAProcessing> AcquireInstance();
+    void ReleaseInstance(std::unique_ptr<TGAProcessing> instance);
+
+    double RunPipelined(std::vector<t_batchjob>& jobs, float scaleFactor, resizeMethod interpolationMethod);
+};
+
+
+#endif	//BATCHPROCESSOR_H
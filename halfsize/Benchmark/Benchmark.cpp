@@ -0,0 +1,670 @@
+/**
+Benchmark suite
+
+Google Benchmark style microbenchmarks of every stage on synthetic 8, 16, 24 and 32 bit TGA images from
+256x256 up to 16384x16384: the planar reference path (deinterleave, nn and bilinear interpolation,
+interleave), the fused kernels, ReadImage / WriteImage (LoadImage / SaveImage through std::fstream),
+LoadImage with parallel positional reads through the page cache and direct,
+the resize methods with and without linear light, the linear light kernels, ResizeImageBuffer on padded rows, the full LoadImage -> ResizeImage -> SaveImage path,
+the same path when the output cache has the image, and a batch of images run one after another and pipelined. Each benchmark runs until --min-time has passed and reports the time per
+iteration, ns per source pixel and GB/s moved.
+
+Build (from the halfsize folder):
+    cmake -S . -B build && cmake --build build
+    build/halfsize_bench [--filter TEXT] [--large] [--min-time S] [--threads N] [--scaling] [--allocations]
+
+    --filter TEXT   only the benchmarks whose name contains TEXT, e.g. BM_ReadImage or /32bit/4096
+    --large         also 8192x8192 and 16384x16384, the latter holds about 3 GB at 32 bit
+    --min-time S    minimum time per benchmark in seconds (default 0.2)
+    --threads N     threads of the TGAProcessing benchmarks (default 1, 0 = all cores)
+    --scaling       ResizeImage with 1 to 16 threads on an 8192x8192 image
+    --allocations   only checks that a warmed-up TGAProcessing allocates nothing, exit code 1 if it does
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/Utilities.h"
+#include "../Batch/BatchProcessor.h"
+#include "../TGAProcessing/TGAProcessing.h"
+
+#define BENCH_REPETITIONS   5
+#define BENCH_MIN_TIME      0.2     // seconds per benchmark
+#define BENCH_MAX_ITERATIONS 1000000
+#define BENCH_INPUT_NAME    "halfsize_bench_input.tga"
+#define BENCH_OUTPUT_NAME   "halfsize_bench_output.tga"
+#define BENCH_BATCH_NAME    "halfsize_bench_batch_"
+#define BENCH_BATCH_IMAGES  4
+#define BENCH_CACHE_NAME    "halfsize_bench_cache"
+#define BENCH_ROW_PADDING   64      // bytes after every row of the strided buffers
+
+#define SCALING_WIDTH       8192
+#define SCALING_HEIGHT      8192
+#define SCALING_FILE_NAME   "halfsize_bench_scaling.tga"
+
+#define ALLOC_LARGE_NAME    "halfsize_bench_alloc_large.tga"
+#define ALLOC_SMALL_NAME    "halfsize_bench_alloc_small.tga"
+#define ALLOC_WARM_UP       2       // runs before the allocations are counted
+#define ALLOC_QUIET_RUNS    3       // then warm-up runs until this many in a row allocate nothing...
+#define ALLOC_MAX_WARM_UP   20      // ...or this many runs in all
+
+
+typedef struct
+{
+    std::string filter;
+    bool        large;
+    double      minTime;
+    size_t      threadCount;
+    bool        scaling;
+    bool        allocations;
+} t_benchsettings;
+
+
+// ======================================================
+// Every heap allocation of the process goes through these, for the --allocations check
+
+static std::atomic<size_t> allocationCount(0);
+
+void* operator new(size_t size)
+{
+    allocationCount++;
+    void* memory = std::malloc(size ? size : 1);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+
+static void fill_synthetic(char* pixelData, size_t size)
+{
+    uint32_t seed = 0x12345678u;
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        pixelData[i] = static_cast<char>(seed >> 24);
+    }
+}
+
+template <typename Func>
+static double best_of(Func func)
+{
+    double best = 1e30;
+    for (int rep = 0; rep < BENCH_REPETITIONS; rep++) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto stop = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+// Float bilinear kernel replaced by the 16.16 fixed-point one, kept to compare the two
+static void bilinear_interpolation_float(const char* originalImagePixelData, int width, int height, size_t bitDepth,
+    char* resizedImagePixelData, int newWidth, int newHeight)
+{
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(originalImagePixelData);
+    unsigned char* outputPixel = reinterpret_cast<unsigned char*>(resizedImagePixelData);
+
+    const float x_ratio = static_cast<float>(width) / static_cast<float>(newWidth);
+    const float y_ratio = static_cast<float>(height) / static_cast<float>(newHeight);
+    const size_t rowSize = static_cast<size_t>(width) * bitDepth;
+
+    // pixel centres aligned and clamped to the image, like bilinear_sample
+    for (int i = 0; i < newHeight; i++) {
+        const float y_position = std::min(std::max((static_cast<float>(i) + 0.5f) * y_ratio - 0.5f, 0.0f), static_cast<float>(height - 1));
+        const int y = static_cast<int>(y_position);
+        const float y_diff = y_position - static_cast<float>(y);
+        const int y_next = (y + 1 < height) ? y + 1 : y;
+
+        for (int j = 0; j < newWidth; j++) {
+            const float x_position = std::min(std::max((static_cast<float>(j) + 0.5f) * x_ratio - 0.5f, 0.0f), static_cast<float>(width - 1));
+            const int x = static_cast<int>(x_position);
+            const float x_diff = x_position - static_cast<float>(x);
+            const int x_next = (x + 1 < width) ? x + 1 : x;
+
+            const unsigned char* a = input + static_cast<size_t>(y) * rowSize + static_cast<size_t>(x) * bitDepth;
+            const unsigned char* b = input + static_cast<size_t>(y) * rowSize + static_cast<size_t>(x_next) * bitDepth;
+            const unsigned char* c = input + static_cast<size_t>(y_next) * rowSize + static_cast<size_t>(x) * bitDepth;
+            const unsigned char* d = input + static_cast<size_t>(y_next) * rowSize + static_cast<size_t>(x_next) * bitDepth;
+
+            for (size_t chn = 0; chn < bitDepth; chn++) {
+                const float pixel = a[chn] * (1 - x_diff) * (1 - y_diff) + b[chn] * (x_diff) * (1 - y_diff) +
+                                    c[chn] * (y_diff) * (1 - x_diff) + d[chn] * (x_diff * y_diff);
+                outputPixel[chn] = static_cast<unsigned char>(pixel + 0.5f);
+            }
+            outputPixel += bitDepth;
+        }
+    }
+}
+
+static bool write_synthetic_tga(const std::string& fileName, int width, int height, char pixelDepth)
+{
+    std::fstream file(fileName, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    // uncompressed greyscale or true colour header, top-left origin
+    const char imageType = (pixelDepth == 8) ? 3 : 2;
+    const char header[18] = { 0, 0, imageType, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                              static_cast<char>(width & 0xFF), static_cast<char>(width >> 8),
+                              static_cast<char>(height & 0xFF), static_cast<char>(height >> 8),
+                              pixelDepth, 0x20 };
+    file.write(header, sizeof(header));
+
+    const size_t rowSize = static_cast<size_t>(width) * ((pixelDepth + IMAGEBIT_SIZE - 1) / IMAGEBIT_SIZE);
+    std::vector<char> row(rowSize);
+    for (int y = 0; y < height; y++) {
+        fill_synthetic(row.data(), rowSize);
+        row[0] = static_cast<char>(y);
+        file.write(row.data(), rowSize);
+    }
+    return file.good();
+}
+
+static void print_table_header()
+{
+    std::cout << std::left << std::setw(40) << "Benchmark" << std::right << std::setw(14) << "Time"
+              << std::setw(12) << "Iterations" << std::setw(12) << "ns/pixel" << std::setw(10) << "GB/s" << std::endl;
+    std::cout << std::string(88, '-') << std::endl;
+}
+
+/**
+* Runs func until settings.minTime has passed, after one warm-up call
+*
+* @param name   - benchmark name, BM_Stage/depth/size
+* @param pixels - source pixels per iteration, for ns/pixel
+* @param bytes  - bytes read and written per iteration, for GB/s
+*/
+static void run_benchmark(const t_benchsettings& settings, const std::string& name, size_t pixels, size_t bytes,
+    const std::function<void()>& func)
+{
+    if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos)
+        return;
+
+    func();
+
+    size_t iterations = 1;
+    double seconds = 0.0;
+    for (;;) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            func();
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds >= settings.minTime || iterations >= BENCH_MAX_ITERATIONS)
+            break;
+
+        // aim past the minimum time, at most 10x more iterations per round
+        const double factor = (seconds > 0.0) ? 1.4 * settings.minTime / seconds : 10.0;
+        iterations = static_cast<size_t>(static_cast<double>(iterations) * ((factor < 10.0) ? factor : 10.0)) + 1;
+    }
+
+    const double perIteration = seconds / static_cast<double>(iterations);
+    std::cout << std::left << std::setw(40) << name << std::right
+              << std::setw(11) << std::fixed << std::setprecision(3) << perIteration * 1e3 << " ms"
+              << std::setw(12) << iterations
+              << std::setw(12) << std::setprecision(3) << perIteration * 1e9 / static_cast<double>(pixels)
+              << std::setw(10) << std::setprecision(2) << static_cast<double>(bytes) / perIteration / 1e9 << std::endl;
+}
+
+static size_t file_size(const std::string& fileName)
+{
+    std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+    return file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+/**
+* Planar path and fused kernels of one pixel format, on synthetic pixels in memory
+*
+* @param suffix - /depth/size part of the benchmark names
+*/
+template <pixelFormat format>
+static void run_kernels(const t_benchsettings& settings, int width, int height, const std::string& suffix)
+{
+    typedef pixel_traits<format> traits;
+
+    float scaleFactor = SCALING_FACTOR;
+    const size_t bitDepth = traits::bytes;
+    const size_t channels = traits::channels;
+    const size_t pixelArea = static_cast<size_t>(width) * static_cast<size_t>(height);
+    const int newWidth = width / SCALING_FACTOR;
+    const int newHeight = height / SCALING_FACTOR;
+    const size_t newArea = static_cast<size_t>(newWidth) * static_cast<size_t>(newHeight);
+    const size_t rowSize = static_cast<size_t>(width) * bitDepth;
+    const size_t newRowSize = static_cast<size_t>(newWidth) * bitDepth;
+
+    std::unique_ptr<char[]> originalData = std::make_unique<char[]>(pixelArea * bitDepth);
+    std::unique_ptr<char[]> resizedData = std::make_unique<char[]>(newArea * bitDepth);
+    fill_synthetic(originalData.get(), pixelArea * bitDepth);
+
+    // ======================================================
+    // Planar reference path, stage by stage
+    {
+        std::vector<char> blueChn, greenChn, redChn, alphaChn;
+        std::vector<char> blueChnResized(newArea), greenChnResized(newArea), redChnResized(newArea), alphaChnResized(newArea);
+
+        run_benchmark(settings, "BM_Deinterleave" + suffix, pixelArea, pixelArea * bitDepth * 2, [&]() {
+            deinterleave_rgba_channels<format, BGRA>(originalData.get(), width, height, blueChn, greenChn, redChn, alphaChn);
+        });
+        if (blueChn.empty()) {
+            deinterleave_rgba_channels<format, BGRA>(originalData.get(), width, height, blueChn, greenChn, redChn, alphaChn);
+        }
+
+        run_benchmark(settings, "BM_NnInterpolation" + suffix, pixelArea, newArea * channels * 2, [&]() {
+            nn_interpolation<format>(scaleFactor, width, height, blueChn, greenChn, redChn, alphaChn,
+                blueChnResized, greenChnResized, redChnResized, alphaChnResized);
+        });
+        run_benchmark(settings, "BM_BilinearInterpolation" + suffix, pixelArea, newArea * channels * 5, [&]() {
+            bilinear_interpolation<format>(scaleFactor, width, height, blueChn, greenChn, redChn, alphaChn,
+                blueChnResized, greenChnResized, redChnResized, alphaChnResized);
+        });
+        run_benchmark(settings, "BM_Interleave" + suffix, pixelArea, newArea * bitDepth * 2, [&]() {
+            interleave_rgba_channels<format, BGRA>(resizedData.get(), width, height,
+                blueChnResized, greenChnResized, redChnResized, alphaChnResized, scaleFactor);
+        });
+    }
+
+    // ======================================================
+    // Fused kernels, one thread
+    run_benchmark(settings, "BM_NnInterleaved" + suffix, pixelArea, newArea * bitDepth * 2, [&]() {
+        nn_interpolation_interleaved<format>(originalData.get(), 0, width, height, rowSize, resizedData.get(), newWidth, newHeight,
+            newRowSize, 0, newHeight);
+    });
+    run_benchmark(settings, "BM_BilinearInterleaved" + suffix, pixelArea, newArea * bitDepth * 5, [&]() {
+        bilinear_interpolation_interleaved<format>(originalData.get(), 0, width, height, rowSize, resizedData.get(), newWidth, newHeight,
+            newRowSize, 0, newHeight);
+    });
+    // the float kernel blends bytes, it has no 16 bit version
+    if (!traits::packed) {
+        run_benchmark(settings, "BM_BilinearFloat" + suffix, pixelArea, newArea * bitDepth * 5, [&]() {
+            bilinear_interpolation_float(originalData.get(), width, height, bitDepth, resizedData.get(), newWidth, newHeight);
+        });
+    }
+    run_benchmark(settings, "BM_BoxFilter2x" + suffix, pixelArea, (pixelArea + newArea) * bitDepth, [&]() {
+        box_filter_half<format>(originalData.get(), 0, width, height, rowSize, resizedData.get(), newWidth, newHeight, newRowSize,
+            0, newHeight);
+    });
+
+    // ======================================================
+    // Linear light kernels, one thread, the 5 bit format is always filtered as stored
+    if (linear_light_supported(format)) {
+        run_benchmark(settings, "BM_BoxFilter2xLinear" + suffix, pixelArea, (pixelArea + newArea) * bitDepth, [&]() {
+            box_filter_half_linear<format>(originalData.get(), 0, width, height, rowSize, resizedData.get(), newWidth, newHeight,
+                newRowSize, 0, newHeight);
+        });
+        run_benchmark(settings, "BM_BilinearLinear" + suffix, pixelArea, newArea * bitDepth * 5, [&]() {
+            bilinear_interpolation_linear<format>(originalData.get(), 0, width, height, rowSize, resizedData.get(), newWidth,
+                newHeight, newRowSize, 0, newHeight);
+        });
+    }
+}
+
+static void run_suite(const t_benchsettings& settings, int size, char pixelDepth)
+{
+    const int width = size;
+    const int height = size;
+
+    const size_t bitDepth = (pixelDepth + IMAGEBIT_SIZE - 1) / IMAGEBIT_SIZE;
+    const size_t pixelArea = static_cast<size_t>(width) * static_cast<size_t>(height);
+    const int newWidth = width / SCALING_FACTOR;
+    const int newHeight = height / SCALING_FACTOR;
+    const size_t newArea = static_cast<size_t>(newWidth) * static_cast<size_t>(newHeight);
+    const std::string suffix = "/" + std::to_string(pixelDepth) + "bit/" + std::to_string(size);
+
+    // the pixel format is picked once, the kernels are instantiated for it
+    switch (pixelDepth) {
+    case 8:  run_kernels<PIXELFORMAT_GREY8>(settings, width, height, suffix); break;
+    case 16: run_kernels<PIXELFORMAT_RGB555>(settings, width, height, suffix); break;
+    case 24: run_kernels<PIXELFORMAT_BGR24>(settings, width, height, suffix); break;
+    default: run_kernels<PIXELFORMAT_BGRA32>(settings, width, height, suffix); break;
+    }
+
+    // ======================================================
+    // TGAProcessing stages on a file
+    if (!write_synthetic_tga(BENCH_INPUT_NAME, width, height, pixelDepth)) {
+        std::cout << "Could not write " << BENCH_INPUT_NAME << std::endl;
+        return;
+    }
+    const size_t inputBytes = file_size(BENCH_INPUT_NAME);
+    const size_t outputBytes = TGA_HEADER_SIZE + newArea * bitDepth;
+
+    {
+        TGAProcessing tgaImageProcessing;
+        tgaImageProcessing.SetThreadCount(settings.threadCount);
+        tgaImageProcessing.SetMemoryMapping(false);
+
+        run_benchmark(settings, "BM_ReadImage" + suffix, pixelArea, inputBytes, [&]() {
+            tgaImageProcessing.LoadImage(BENCH_INPUT_NAME);
+        });
+
+        // the direct reads come from the device every time, the others from the page cache once warm
+        tgaImageProcessing.SetParallelRead(true);
+        run_benchmark(settings, "BM_ReadImage/pread" + suffix, pixelArea, inputBytes, [&]() {
+            tgaImageProcessing.LoadImage(BENCH_INPUT_NAME);
+        });
+        tgaImageProcessing.SetDirectIo(true);
+        run_benchmark(settings, "BM_ReadImage/direct" + suffix, pixelArea, inputBytes, [&]() {
+            tgaImageProcessing.LoadImage(BENCH_INPUT_NAME);
+        });
+        tgaImageProcessing.SetDirectIo(false);
+        tgaImageProcessing.SetParallelRead(false);
+        tgaImageProcessing.LoadImage(BENCH_INPUT_NAME);
+
+        const resizeMethod methods[] = { NEAREST_NEIGHBOR, BILINEAR_INTERPOL, BOX_FILTER_2X, AREA_FILTER, BICUBIC_FILTER, LANCZOS3_FILTER };
+        const char* methodNames[] = { "nearest", "bilinear", "box", "area", "bicubic", "lanczos3" };
+        for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+            run_benchmark(settings, std::string("BM_ResizeImage/") + methodNames[m] + suffix, pixelArea,
+                (pixelArea + newArea) * bitDepth, [&]() {
+                tgaImageProcessing.ResizeImage(SCALING_FACTOR, methods[m]);
+            });
+        }
+        if (pixelDepth != 16) {
+            tgaImageProcessing.SetLinearLight(true);
+            for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+                run_benchmark(settings, std::string("BM_ResizeImage/") + methodNames[m] + "-linear" + suffix, pixelArea,
+                    (pixelArea + newArea) * bitDepth, [&]() {
+                    tgaImageProcessing.ResizeImage(SCALING_FACTOR, methods[m]);
+                });
+            }
+            tgaImageProcessing.SetLinearLight(false);
+        }
+
+        {
+            // caller-owned buffers with padded rows, as a texture atlas would hand them over
+            const pixelFormat format = (pixelDepth == 8) ? PIXELFORMAT_GREY8 : (pixelDepth == 16) ? PIXELFORMAT_RGB555 :
+                                       (pixelDepth == 24) ? PIXELFORMAT_BGR24 : PIXELFORMAT_BGRA32;
+            const size_t rowStride = static_cast<size_t>(width) * bitDepth + BENCH_ROW_PADDING;
+            const size_t newRowStride = static_cast<size_t>(newWidth) * bitDepth + BENCH_ROW_PADDING;
+            std::vector<char> sourcePixels(rowStride * static_cast<size_t>(height));
+            std::vector<char> targetPixels(newRowStride * static_cast<size_t>(newHeight));
+            fill_synthetic(sourcePixels.data(), sourcePixels.size());
+
+            const t_imagebuffer source = { sourcePixels.data(), width, height, rowStride, format };
+            const t_imagebuffer target = { targetPixels.data(), newWidth, newHeight, newRowStride, format };
+            run_benchmark(settings, "BM_ResizeBuffer/strided" + suffix, pixelArea, (pixelArea + newArea) * bitDepth, [&]() {
+                tgaImageProcessing.ResizeImageBuffer(source, target, BOX_FILTER_2X);
+            });
+        }
+
+        tgaImageProcessing.ResizeImage(SCALING_FACTOR, BOX_FILTER_2X);
+        run_benchmark(settings, "BM_WriteImage" + suffix, pixelArea, outputBytes, [&]() {
+            tgaImageProcessing.SaveImage(BENCH_OUTPUT_NAME);
+        });
+
+        run_benchmark(settings, "BM_FullPath" + suffix, pixelArea, inputBytes + outputBytes, [&]() {
+            tgaImageProcessing.LoadImage(BENCH_INPUT_NAME);
+            tgaImageProcessing.ResizeImage(SCALING_FACTOR, BOX_FILTER_2X);
+            tgaImageProcessing.SaveImage(BENCH_OUTPUT_NAME);
+        });
+    }
+    {
+        TGAProcessing tgaImageProcessing;
+        tgaImageProcessing.SetThreadCount(settings.threadCount);
+
+        run_benchmark(settings, "BM_FullPath/mmap" + suffix, pixelArea, inputBytes + outputBytes, [&]() {
+            tgaImageProcessing.LoadImage(BENCH_INPUT_NAME);
+            tgaImageProcessing.ResizeImageToFile(BENCH_OUTPUT_NAME, SCALING_FACTOR, BOX_FILTER_2X);
+        });
+    }
+    {
+        // every run after the first finds the image in the cache: the pixels are hashed instead of resized
+        TGAProcessing tgaImageProcessing;
+        tgaImageProcessing.SetThreadCount(settings.threadCount);
+        tgaImageProcessing.SetOutputCache(std::make_shared<OutputCache>(BENCH_CACHE_NAME, OUTPUT_CACHE_DEFAULT_SIZE));
+
+        run_benchmark(settings, "BM_FullPath/cached" + suffix, pixelArea, inputBytes + outputBytes, [&]() {
+            tgaImageProcessing.LoadImage(BENCH_INPUT_NAME);
+            tgaImageProcessing.ResizeImageToFile(BENCH_OUTPUT_NAME, SCALING_FACTOR, BOX_FILTER_2X);
+        });
+
+        // a size limit of 0 empties the cache
+        OutputCache emptyCache(BENCH_CACHE_NAME, 0);
+    }
+    std::remove(BENCH_CACHE_NAME);
+    {
+        // the same file BENCH_BATCH_IMAGES times, one image after another and as a read/resize/write pipeline
+        std::vector<t_batchjob> jobs(BENCH_BATCH_IMAGES);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            jobs[i].inputFileName = BENCH_INPUT_NAME;
+            jobs[i].outputFileName = BENCH_BATCH_NAME + std::to_string(i) + ".tga";
+        }
+
+        BatchProcessor batchProcessor(std::make_shared<ThreadPool>(settings.threadCount));
+        for (int pipelined = 0; pipelined < 2; pipelined++) {
+            batchProcessor.SetPipelined(pipelined != 0);
+            run_benchmark(settings, std::string(pipelined ? "BM_Batch/pipeline" : "BM_Batch") + suffix,
+                pixelArea * jobs.size(), (inputBytes + outputBytes) * jobs.size(), [&]() {
+                batchProcessor.Run(jobs, SCALING_FACTOR, BOX_FILTER_2X);
+            });
+        }
+
+        for (const t_batchjob& job : jobs) {
+            std::remove(job.outputFileName.c_str());
+        }
+    }
+
+    std::remove(BENCH_INPUT_NAME);
+    std::remove(BENCH_OUTPUT_NAME);
+}
+
+static void run_thread_scaling(char pixelDepth)
+{
+    if (!write_synthetic_tga(SCALING_FILE_NAME, SCALING_WIDTH, SCALING_HEIGHT, pixelDepth)) {
+        std::cout << "Could not write " << SCALING_FILE_NAME << std::endl;
+        return;
+    }
+
+    TGAProcessing tgaImageProcessing;
+    if (FILE_OK != tgaImageProcessing.LoadImage(SCALING_FILE_NAME)) {
+        std::cout << "Could not read " << SCALING_FILE_NAME << std::endl;
+        std::remove(SCALING_FILE_NAME);
+        return;
+    }
+
+    std::cout << "ResizeImage " << SCALING_WIDTH << "x" << SCALING_HEIGHT << " " << static_cast<int>(pixelDepth)
+              << " bit, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+    const resizeMethod methods[] = { NEAREST_NEIGHBOR, BILINEAR_INTERPOL, BOX_FILTER_2X, AREA_FILTER, BICUBIC_FILTER, LANCZOS3_FILTER };
+    const char* methodNames[] = { "nearest neighbor", "bilinear", "box 2x", "area", "bicubic", "lanczos3" };
+    const size_t threadCounts[] = { 1, 2, 4, 8, 16 };
+
+    for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+        double singleThread = 0.0;
+        for (size_t threadCount : threadCounts) {
+            tgaImageProcessing.SetThreadCount(threadCount);
+            const double seconds = best_of([&]() { tgaImageProcessing.ResizeImage(SCALING_FACTOR, methods[m]); });
+            if (threadCount == 1)
+                singleThread = seconds;
+
+            std::cout << std::left << std::setw(18) << methodNames[m] << std::right << std::setw(3) << threadCount << " threads"
+                      << std::setw(10) << std::fixed << std::setprecision(2) << seconds * 1e3 << " ms"
+                      << std::setw(8) << singleThread / seconds << "x" << std::endl;
+        }
+    }
+    std::cout << std::endl;
+
+    std::remove(SCALING_FILE_NAME);
+}
+
+/**
+* Loads, resizes and saves a large image ALLOC_WARM_UP times, then counts the heap allocations of one more
+* run on the same image and of one run on a smaller image, for every method and output path
+* The kernels keep their scratch per thread, and a pool thread that stole no band during the first runs
+* grows it later: the warm-up goes on until ALLOC_QUIET_RUNS runs in a row allocate nothing.
+*
+* @return number of configurations that allocated after the warm-up
+*/
+static int run_allocation_check(const t_benchsettings& settings)
+{
+    if (!write_synthetic_tga(ALLOC_LARGE_NAME, 1024, 768, 32) || !write_synthetic_tga(ALLOC_SMALL_NAME, 700, 500, 32)) {
+        std::cout << "Could not write the allocation check images" << std::endl;
+        return 1;
+    }
+
+    const std::string largeName(ALLOC_LARGE_NAME);
+    const std::string smallName(ALLOC_SMALL_NAME);
+    const std::string outputName(BENCH_OUTPUT_NAME);
+
+    const resizeMethod methods[] = { NEAREST_NEIGHBOR, BILINEAR_INTERPOL, BOX_FILTER_2X, AREA_FILTER, BICUBIC_FILTER, LANCZOS3_FILTER };
+    const char* methodNames[] = { "nearest", "bilinear", "box", "area", "bicubic", "lanczos3" };
+    const char* sourceNames[] = { "/fstream", "/mmap", "/pread" };
+    const size_t threadCounts[] = { 1, (settings.threadCount > 1) ? settings.threadCount : 4 };
+    int failures = 0;
+
+    for (size_t threadCount : threadCounts) {
+        for (int source = 0; source < 3; source++) {
+            // std::fstream, mapping, parallel reads
+            const bool mapped = (source == 1);
+            for (int variant = 0; variant < 3; variant++) {
+                // plain, run-length encoded output, linear light
+                const bool rle = (variant == 1);
+                const bool linear = (variant == 2);
+                for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+                    // streaming releases the whole-image buffer on purpose, it runs on an instance of its own
+                    TGAProcessing tgaImageProcessing;
+                    TGAProcessing streamingProcessing;
+                    for (TGAProcessing* instance : { &tgaImageProcessing, &streamingProcessing }) {
+                        instance->SetThreadCount(threadCount);
+                        instance->SetMemoryMapping(mapped);
+                        instance->SetParallelRead(source == 2);
+                        instance->SetRleOutput(rle);
+                        instance->SetLinearLight(linear);
+                    }
+
+                    auto process = [&](const std::string& inputName) {
+                        tgaImageProcessing.LoadImage(inputName);
+                        tgaImageProcessing.ResizeImage(SCALING_FACTOR, methods[m]);
+                        tgaImageProcessing.SaveImage(outputName);
+                        tgaImageProcessing.ResizeImageToFile(outputName, SCALING_FACTOR, methods[m]);
+                        streamingProcessing.ResizeImageStreaming(inputName, outputName, SCALING_FACTOR, methods[m]);
+                    };
+
+                    int quietRuns = 0;
+                    for (int run = 0; run < ALLOC_MAX_WARM_UP && (run < ALLOC_WARM_UP || quietRuns < ALLOC_QUIET_RUNS); run++) {
+                        const size_t runStart = allocationCount.load();
+                        process(largeName);
+                        quietRuns = (allocationCount.load() == runStart) ? quietRuns + 1 : 0;
+                    }
+                    const size_t before = allocationCount.load();
+                    process(largeName);
+                    process(smallName);
+                    const size_t allocations = allocationCount.load() - before;
+
+                    std::cout << "BM_Allocations/" << methodNames[m] << "/" << threadCount << "threads"
+                              << sourceNames[source] << (rle ? "/rle" : "") << (linear ? "/linear" : "") << "  " << allocations << std::endl;
+                    if (allocations != 0) {
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+
+    std::remove(ALLOC_LARGE_NAME);
+    std::remove(ALLOC_SMALL_NAME);
+    std::remove(BENCH_OUTPUT_NAME);
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    t_benchsettings settings;
+    settings.large = false;
+    settings.minTime = BENCH_MIN_TIME;
+    settings.threadCount = 1;
+    settings.scaling = false;
+    settings.allocations = false;
+
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        const std::string arg(argv[argIdx]);
+
+        if (arg == "--filter" && argIdx + 1 < argc) {
+            settings.filter = argv[++argIdx];
+        }
+        else if (arg == "--large") {
+            settings.large = true;
+        }
+        else if (arg == "--min-time" && argIdx + 1 < argc) {
+            settings.minTime = std::strtod(argv[++argIdx], nullptr);
+        }
+        else if (arg == "--threads" && argIdx + 1 < argc) {
+            settings.threadCount = static_cast<size_t>(std::strtoul(argv[++argIdx], nullptr, 10));
+        }
+        else if (arg == "--scaling") {
+            settings.scaling = true;
+        }
+        else if (arg == "--allocations") {
+            settings.allocations = true;
+        }
+        else {
+            std::cout << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (settings.allocations) {
+        const int failures = run_allocation_check(settings);
+        std::cout << failures << " configurations allocated after the warm-up" << std::endl;
+        return (failures == 0) ? 0 : 1;
+    }
+
+    std::vector<int> sizes = { 256, 1024, 4096 };
+    if (settings.large) {
+        sizes.push_back(8192);
+        sizes.push_back(16384);
+    }
+
+    print_table_header();
+    for (int size : sizes) {
+        run_suite(settings, size, 8);
+        run_suite(settings, size, 16);
+        run_suite(settings, size, 24);
+        run_suite(settings, size, 32);
+    }
+    std::cout << std::endl;
+
+    if (settings.scaling) {
+        run_thread_scaling(24);
+        run_thread_scaling(32);
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+#include "BoxFilter.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BOX_FILTER_X86      1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa)    __attribute__((target(isa)))
+#endif
+#else
+#define BOX_FILTER_X86      0
+#endif
+
+
+simdLevel detect_simd_level()
+{
+#if BOX_FILTER_X86
+    static const simdLevel level = []() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse2 = (info[3] & (1 << 26)) != 0;
+        const bool ssse3 = (info[2] & (1 << 9)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx2 = false;
+        if (maxLeaf >= 7 && osxsave && ((_xgetbv(0) & 0x6) == 0x6)) {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#else
+        __builtin_cpu_init();
+        const bool sse2 = __builtin_cpu_supports("sse2");
+        const bool ssse3 = __builtin_cpu_supports("ssse3");
+        const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+        if (avx2)
+            return SIMD_AVX2;
+        if (ssse3)
+            return SIMD_SSSE3;
+        if (sse2)
+            return SIMD_SSE2;
+        return SIMD_SCALAR;
+    }();
+    return level;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+// ======================================================
+// Scalar
+
+template <pixelFormat format>
+static void box_filter_half_row_scalar(const unsigned char* inputRow0, const unsigned char* inputRow1,
+    unsigned char* outputRow, int firstPixel, int newWidth)
+{
+    typedef pixel_traits<format> traits;
+
+    for (int j = firstPixel; j < newWidth; j++) {
+        const size_t left = static_cast<size_t>(j) * 2 * traits::bytes;
+        const size_t right = left + traits::bytes;
+
+        unsigned int a[traits::channels], b[traits::channels], c[traits::channels], d[traits::channels];
+        traits::load(inputRow0 + left, a);
+        traits::load(inputRow0 + right, b);
+        traits::load(inputRow1 + left, c);
+        traits::load(inputRow1 + right, d);
+
+        unsigned int average[traits::channels];
+        for (size_t chn = 0; chn < traits::channels; chn++) {
+            average[chn] = (a[chn] + b[chn] + c[chn] + d[chn] + 2) >> 2;
+        }
+        traits::store(average, outputRow + static_cast<size_t>(j) * traits::bytes);
+    }
+}
+
+#if BOX_FILTER_X86
+// ======================================================
+// SSE2 / SSSE3
+
+// 4 BGRA pixels of two rows -> 2 averaged pixels as 16 bit lanes
+SIMD_TARGET("sse2") static inline __m128i box_bgra_sse2(__m128i row0, __m128i row1)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+    const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+    const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+SIMD_TARGET("sse2") static int box_filter_half_row_bgra_sse2(const unsigned char* inputRow0,
+    const unsigned char* inputRow1, unsigned char* outputRow, int newWidth)
+{
+    int j = 0;
+    for (; j + 4 <= newWidth; j += 4) {
+        const size_t offset = static_cast<size_t>(j) * 8;
+        const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow0 + offset));
+        const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow0 + offset + 16));
+        const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow1 + offset));
+        const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow1 + offset + 16));
+
+        const __m128i result = _mm_packus_epi16(box_bgra_sse2(a0, b0), box_bgra_sse2(a1, b1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(outputRow + static_cast<size_t>(j) * 4), result);
+    }
+    return j;
+}
+
+SIMD_TARGET("ssse3") static int box_filter_half_row_bgr_ssse3(const unsigned char* inputRow0,
+    const unsigned char* inputRow1, unsigned char* outputRow, int newWidth)
+{
+    // BGR -> BGR0 and back
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i compress = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    int j = 0;
+    // each 16 byte load reads 4 bytes past the 12 it uses, keep one pixel of slack at the row end
+    for (; j + 5 <= newWidth; j += 4) {
+        const size_t offset = static_cast<size_t>(j) * 6;
+        const __m128i a0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow0 + offset)), expand);
+        const __m128i a1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow0 + offset + 12)), expand);
+        const __m128i b0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow1 + offset)), expand);
+        const __m128i b1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow1 + offset + 12)), expand);
+
+        const __m128i result = _mm_shuffle_epi8(_mm_packus_epi16(box_bgra_sse2(a0, b0), box_bgra_sse2(a1, b1)), compress);
+
+        unsigned char* outputPixel = outputRow + static_cast<size_t>(j) * 3;
+        const int tail = _mm_cvtsi128_si32(_mm_srli_si128(result, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(outputPixel), result);
+        memcpy(outputPixel + 8, &tail, 4);
+    }
+    return j;
+}
+
+// ======================================================
+// AVX2
+
+// 8 BGRA pixels of two rows -> 4 averaged pixels as 16 bit lanes, 2 per 128 bit lane
+SIMD_TARGET("avx2") static inline __m256i box_bgra_avx2(__m256i row0, __m256i row1)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(row0, zero), _mm256_unpacklo_epi8(row1, zero));
+    const __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(row0, zero), _mm256_unpackhi_epi8(row1, zero));
+    const __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+SIMD_TARGET("avx2") static inline __m256i load_bgr_avx2(const unsigned char* input, __m256i expand)
+{
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 12));
+    return _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), expand);
+}
+
+SIMD_TARGET("avx2") static int box_filter_half_row_bgra_avx2(const unsigned char* inputRow0,
+    const unsigned char* inputRow1, unsigned char* outputRow, int newWidth)
+{
+    int j = 0;
+    for (; j + 8 <= newWidth; j += 8) {
+        const size_t offset = static_cast<size_t>(j) * 8;
+        const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputRow0 + offset));
+        const __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputRow0 + offset + 32));
+        const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputRow1 + offset));
+        const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputRow1 + offset + 32));
+
+        // packus works per 128 bit lane, restore the pixel order afterwards
+        const __m256i packed = _mm256_packus_epi16(box_bgra_avx2(a0, b0), box_bgra_avx2(a1, b1));
+        const __m256i result = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(outputRow + static_cast<size_t>(j) * 4), result);
+    }
+    return j;
+}
+
+SIMD_TARGET("avx2") static int box_filter_half_row_bgr_avx2(const unsigned char* inputRow0,
+    const unsigned char* inputRow1, unsigned char* outputRow, int newWidth)
+{
+    const __m256i expand = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i compress = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                              0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    int j = 0;
+    // the last 16 byte load reads 4 bytes past the 48 it uses, keep one pixel of slack at the row end
+    for (; j + 9 <= newWidth; j += 8) {
+        const size_t offset = static_cast<size_t>(j) * 6;
+        const __m256i a0 = load_bgr_avx2(inputRow0 + offset, expand);
+        const __m256i a1 = load_bgr_avx2(inputRow0 + offset + 24, expand);
+        const __m256i b0 = load_bgr_avx2(inputRow1 + offset, expand);
+        const __m256i b1 = load_bgr_avx2(inputRow1 + offset + 24, expand);
+
+        const __m256i packed = _mm256_packus_epi16(box_bgra_avx2(a0, b0), box_bgra_avx2(a1, b1));
+        const __m256i result = _mm256_shuffle_epi8(_mm256_permute4x64_epi64(packed, 0xD8), compress);
+
+        unsigned char* outputPixel = outputRow + static_cast<size_t>(j) * 3;
+        unsigned char lanes[32];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), result);
+        memcpy(outputPixel, lanes, 12);
+        memcpy(outputPixel + 12, lanes + 16, 12);
+    }
+    return j;
+}
+#endif
+
+// ======================================================
+
+template <pixelFormat format>
+void box_filter_half_row(const unsigned char* inputRow0, const unsigned char* inputRow1, unsigned char* outputRow,
+    int newWidth, simdLevel level)
+{
+    int firstPixel = 0;
+
+#if BOX_FILTER_X86
+    if (PIXELFORMAT_BGRA32 == format) {
+        if (level >= SIMD_AVX2)
+            firstPixel = box_filter_half_row_bgra_avx2(inputRow0, inputRow1, outputRow, newWidth);
+        else if (level >= SIMD_SSE2)
+            firstPixel = box_filter_half_row_bgra_sse2(inputRow0, inputRow1, outputRow, newWidth);
+    }
+    else if (PIXELFORMAT_BGR24 == format) {
+        if (level >= SIMD_AVX2)
+            firstPixel = box_filter_half_row_bgr_avx2(inputRow0, inputRow1, outputRow, newWidth);
+        else if (level >= SIMD_SSSE3)
+            firstPixel = box_filter_half_row_bgr_ssse3(inputRow0, inputRow1, outputRow, newWidth);
+    }
+#else
+    (void)level;
+#endif
+
+    box_filter_half_row_scalar<format>(inputRow0, inputRow1, outputRow, firstPixel, newWidth);
+}
+
+template <pixelFormat format>
+void box_filter_half(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow)
+{
+    (void)height;
+    (void)newWidth;
+    (void)newHeight;
+
+    // an odd last column is dropped whatever size the caller rounded to
+    const simdLevel level = detect_simd_level();
+    const int halfWidth = width / 2;
+
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(originalImagePixelData);
+    unsigned char* output = reinterpret_cast<unsigned char*>(resizedImagePixelData);
+
+    for (int i = firstRow; i < endRow; i++) {
+        const unsigned char* inputRow0 = input + static_cast<size_t>(i * 2 - firstSourceRow) * rowStride;
+        box_filter_half_row<format>(inputRow0, inputRow0 + rowStride, output + static_cast<size_t>(i - firstRow) * newRowStride,
+            halfWidth, level);
+    }
+}
+
+template <pixelFormat format>
+void box_filter_mip(const char* previousLevelPixelData, int width, int height,
+    char* levelPixelData, int firstRow, int endRow)
+{
+    typedef pixel_traits<format> traits;
+
+    const simdLevel level = detect_simd_level();
+    const int newWidth = (width > 1) ? width / 2 : 1;
+    const size_t rowSize = static_cast<size_t>(width) * traits::bytes;
+    const size_t newRowSize = static_cast<size_t>(newWidth) * traits::bytes;
+
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(previousLevelPixelData);
+    unsigned char* output = reinterpret_cast<unsigned char*>(levelPixelData);
+
+    for (int i = firstRow; i < endRow; i++) {
+        // a single row is averaged with itself, (2a + 2b + 2) / 4 = (a + b + 1) / 2
+        const unsigned char* inputRow0 = input + static_cast<size_t>((height > 1) ? i * 2 : i) * rowSize;
+        const unsigned char* inputRow1 = (height > 1) ? inputRow0 + rowSize : inputRow0;
+        unsigned char* outputRow = output + static_cast<size_t>(i - firstRow) * newRowSize;
+
+        if (width > 1) {
+            box_filter_half_row<format>(inputRow0, inputRow1, outputRow, newWidth, level);
+        }
+        else {
+            unsigned int a[traits::channels], b[traits::channels];
+            traits::load(inputRow0, a);
+            traits::load(inputRow1, b);
+            for (size_t chn = 0; chn < traits::channels; chn++) {
+                a[chn] = (a[chn] + b[chn] + 1) >> 1;
+            }
+            traits::store(a, outputRow);
+        }
+    }
+}
+
+// ======================================================
+// One instance of each kernel per pixel format
+
+#define BOX_FILTER_INSTANTIATE(format) \
+    template void box_filter_half_row<format>(const unsigned char*, const unsigned char*, unsigned char*, int, simdLevel); \
+    template void box_filter_half<format>(const char*, int, int, int, size_t, char*, int, int, size_t, int, int); \
+    template void box_filter_mip<format>(const char*, int, int, char*, int, int);
+
+BOX_FILTER_INSTANTIATE(PIXELFORMAT_GREY8)
+BOX_FILTER_INSTANTIATE(PIXELFORMAT_RGB555)
+BOX_FILTER_INSTANTIATE(PIXELFORMAT_BGR24)
+BOX_FILTER_INSTANTIATE(PIXELFORMAT_BGRA32)
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+
+#include "Utilities.h"
+
+
+enum simdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2   = 1,
+    SIMD_SSSE3  = 2,
+    SIMD_AVX2   = 3
+};
+
+
+/**
+* Detects the best instruction set supported by the running CPU
+* The result is computed once and cached
+*
+* @return highest usable simdLevel
+*/
+simdLevel detect_simd_level();
+
+/**
+* 2x2 box filter of one output row
+*
+* Each output pixel is the rounded average (a + b + c + d + 2) / 4 of a 2x2 block, channel by channel,
+* all instruction set levels produce identical results. Instantiated for every pixelFormat.
+*
+* @param inputRow0  - first source row of the 2x2 blocks
+* @param inputRow1  - second source row of the 2x2 blocks
+* @param outputRow  - destination row holding newWidth pixels
+* @param newWidth   - pixel width of the resized image (source width / 2)
+* @param level      - instruction set to use, SSE2 only covers 32 bit pixels and falls back to scalar for 24 bit,
+*                     the grey and 16 bit formats are scalar
+*/
+template <pixelFormat format>
+void box_filter_half_row(const unsigned char* inputRow0, const unsigned char* inputRow1, unsigned char* outputRow,
+    int newWidth, simdLevel level);
+
+/**
+* Exact 2x downscale with a 2x2 box filter, a t_resizekernel
+* The best instruction set is picked at runtime, an odd last column or row is dropped.
+*
+* @param originalImagePixelData - pointer to the original pixel data, starting at row firstSourceRow
+* @param firstSourceRow         - original image row held at originalImagePixelData (0 for a whole image)
+* @param width                  - pixel width of original image
+* @param height                 - pixel height of original image
+* @param rowStride              - bytes from one original row to the next
+* @param resizedImagePixelData  - pointer to the resized pixel data of row firstRow
+* @param newWidth               - not used, the resized width is always width / 2
+* @param newHeight              - not used, the resized height is always height / 2
+* @param newRowStride           - bytes from one resized row to the next
+* @param firstRow               - first output row to compute
+* @param endRow                 - output row after the last one to compute
+*/
+template <pixelFormat format>
+void box_filter_half(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow);
+
+/**
+Mip level kernel of one pixel format, see box_filter_mip
+*/
+typedef void (*t_mipkernel)(const char* previousLevelPixelData, int width, int height,
+    char* levelPixelData, int firstRow, int endRow);
+
+/**
+* Next mip level with a 2x2 box filter, down to 1x1
+* Like box_filter_half, but a side of 1 pixel stays 1 pixel and the other side is averaged in pairs.
+*
+* @param previousLevelPixelData - pointer to the whole previous level
+* @param width                  - pixel width of previous level
+* @param height                 - pixel height of previous level
+* @param levelPixelData         - pointer to the new level pixel data of row firstRow
+* @param firstRow               - first output row to compute
+* @param endRow                 - output row after the last one to compute
+*/
+template <pixelFormat format>
+void box_filter_mip(const char* previousLevelPixelData, int width, int height,
+    char* levelPixelData, int firstRow, int endRow);
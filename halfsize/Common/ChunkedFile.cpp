@@ -0,0 +1,177 @@
+#include "ChunkedFile.h"
+
+#include <atomic>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+ChunkedFile::ChunkedFile()
+    : size(0), direct(false), fileHandle(INVALID_HANDLE_VALUE)
+{
+}
+
+bool ChunkedFile::OpenRead(const std::string& fileName, bool directIo)
+{
+    Close();
+
+    // the chunks are read out of order, the cache manager should not read ahead sequentially
+    fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        directIo ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_RANDOM_ACCESS, nullptr);
+    direct = directIo && (fileHandle != INVALID_HANDLE_VALUE);
+    if (fileHandle == INVALID_HANDLE_VALUE && directIo) {
+        fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_RANDOM_ACCESS, nullptr);
+    }
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        Close();
+        return false;
+    }
+
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+size_t ChunkedFile::Read(size_t offset, char* destination, size_t length)
+{
+    size_t bytesRead = 0;
+    while (bytesRead < length) {
+        // ReadFile takes 32 bit lengths, the offset in the OVERLAPPED makes it a positional read
+        const DWORD request = static_cast<DWORD>((length - bytesRead < CHUNKED_READ_SIZE) ? length - bytesRead : CHUNKED_READ_SIZE);
+        const unsigned long long position = offset + bytesRead;
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFFull);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+
+        DWORD got = 0;
+        if (!ReadFile(fileHandle, destination + bytesRead, request, &got, &overlapped) || got == 0)
+            break;
+        bytesRead += got;
+    }
+    return bytesRead;
+}
+
+void ChunkedFile::Close()
+{
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+
+    size = 0;
+    direct = false;
+    fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+ChunkedFile::ChunkedFile()
+    : size(0), direct(false), fileDescriptor(-1)
+{
+}
+
+bool ChunkedFile::OpenRead(const std::string& fileName, bool directIo)
+{
+    Close();
+
+#ifdef O_DIRECT
+    if (directIo) {
+        fileDescriptor = open(fileName.c_str(), O_RDONLY | O_DIRECT);
+        direct = (fileDescriptor >= 0);
+    }
+#else
+    (void)directIo;
+#endif
+    if (fileDescriptor < 0) {
+        fileDescriptor = open(fileName.c_str(), O_RDONLY);
+    }
+    if (fileDescriptor < 0)
+        return false;
+
+    struct stat fileInfo;
+    if (fstat(fileDescriptor, &fileInfo) != 0) {
+        Close();
+        return false;
+    }
+
+    size = static_cast<size_t>(fileInfo.st_size);
+
+    // the chunks are read out of order, the kernel should not read ahead sequentially
+    if (!direct) {
+        posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_RANDOM);
+    }
+    return true;
+}
+
+size_t ChunkedFile::Read(size_t offset, char* destination, size_t length)
+{
+    size_t bytesRead = 0;
+    while (bytesRead < length) {
+        const ssize_t got = pread(fileDescriptor, destination + bytesRead, length - bytesRead,
+            static_cast<off_t>(offset + bytesRead));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        bytesRead += static_cast<size_t>(got);
+    }
+    return bytesRead;
+}
+
+void ChunkedFile::Close()
+{
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+
+    size = 0;
+    direct = false;
+    fileDescriptor = -1;
+}
+
+#endif
+
+ChunkedFile::~ChunkedFile()
+{
+    Close();
+}
+
+size_t ChunkedFile::ReadParallel(ThreadPool& threadPool, size_t offset, char* destination, size_t length)
+{
+    if (length <= CHUNKED_READ_SIZE)
+        return Read(offset, destination, length);
+
+    const size_t chunkCount = (length + CHUNKED_READ_SIZE - 1) / CHUNKED_READ_SIZE;
+    std::atomic<size_t> bytesRead(0);
+
+    threadPool.ParallelFor(static_cast<int>(chunkCount), 1, [&](int begin, int end) {
+        for (int chunk = begin; chunk < end; chunk++) {
+            const size_t first = static_cast<size_t>(chunk) * CHUNKED_READ_SIZE;
+            const size_t chunkLength = (length - first < CHUNKED_READ_SIZE) ? length - first : CHUNKED_READ_SIZE;
+            bytesRead += Read(offset + first, destination + first, chunkLength);
+        }
+    });
+
+    return bytesRead.load();
+}
+
+size_t ChunkedFile::GetSize() const
+{
+    return size;
+}
+
+bool ChunkedFile::IsDirect() const
+{
+    return direct;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "../ThreadPool/ThreadPool.h"
+
+
+#define CHUNKED_READ_SIZE       (4 * 1024 * 1024)   // bytes per positional read of ReadParallel(), one task each
+#define DIRECT_IO_ALIGNMENT     4096                // file offsets, lengths and buffer addresses of direct reads are multiples of it
+
+/**
+File read with positional reads (pread, ReadFile at an offset)
+ReadParallel() splits a range into CHUNKED_READ_SIZE chunks read on the threads of a pool, which keeps several
+requests in flight: a single sequential stream gets far less than the bandwidth of NVMe arrays and network
+filesystems. With direct I/O (O_DIRECT, FILE_FLAG_NO_BUFFERING) the reads bypass the page cache and go
+straight into the destination, whose address, offsets and lengths must then be multiples of DIRECT_IO_ALIGNMENT.
+The file is closed on Close() or destruction.
+*/
+class ChunkedFile
+{
+public:
+    ChunkedFile();
+    ~ChunkedFile();
+
+    ChunkedFile(const ChunkedFile&) = delete;
+    ChunkedFile& operator=(const ChunkedFile&) = delete;
+
+    /**
+    * Opens an existing file for reading
+    * Filesystems that refuse direct I/O, e.g. tmpfs, are read through the page cache, see IsDirect()
+    *
+    * @param fileName - path of the file
+    * @param directIo - bypass the page cache
+    * @return true if the file is open
+    */
+    bool OpenRead(const std::string& fileName, bool directIo);
+
+    /**
+    * Reads a range on the calling thread
+    *
+    * @param offset      - first byte of the range in the file
+    * @param destination - receives the bytes
+    * @param length      - bytes in the range
+    * @return bytes read, less than length at the end of the file or on a read error
+    */
+    size_t Read(size_t offset, char* destination, size_t length);
+
+    /**
+    * Reads a range in chunks on the threads of a pool, blocks until all of them are read
+    *
+    * @param threadPool  - pool running the chunks, the calling thread reads too
+    * @param offset      - first byte of the range in the file
+    * @param destination - receives the bytes
+    * @param length      - bytes in the range
+    * @return bytes read, less than length at the end of the file or on a read error
+    */
+    size_t ReadParallel(ThreadPool& threadPool, size_t offset, char* destination, size_t length);
+
+    void Close();
+
+    size_t  GetSize() const;
+    bool    IsDirect() const;
+
+private:
+    size_t  size;
+    bool    direct;
+
+#ifdef _WIN32
+    void*   fileHandle;
+#else
+    int     fileDescriptor;
+#endif
+};
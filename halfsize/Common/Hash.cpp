@@ -0,0 +1,154 @@
+#include "Hash.h"
+
+#include <cstring>
+
+
+// XXH64 as specified in https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+// Words are read little-endian, as on the x86 and ARM targets of the project
+static const uint64_t XXH64_PRIME1 = 11400714785074694791ULL;
+static const uint64_t XXH64_PRIME2 = 14029467366897019727ULL;
+static const uint64_t XXH64_PRIME3 = 1609587929392839161ULL;
+static const uint64_t XXH64_PRIME4 = 9650029242287828579ULL;
+static const uint64_t XXH64_PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotate_left(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const unsigned char* bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const unsigned char* bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint64_t xxh64_round(uint64_t accumulator, uint64_t lane)
+{
+    accumulator += lane * XXH64_PRIME2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * XXH64_PRIME1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= xxh64_round(0, accumulator);
+    return hash * XXH64_PRIME1 + XXH64_PRIME4;
+}
+
+// Runs the four accumulators over whole stripes, returns the bytes consumed
+static size_t xxh64_stripes(uint64_t* accumulators, const unsigned char* data, size_t length)
+{
+    uint64_t v1 = accumulators[0];
+    uint64_t v2 = accumulators[1];
+    uint64_t v3 = accumulators[2];
+    uint64_t v4 = accumulators[3];
+
+    const unsigned char* stripe = data;
+    const unsigned char* end = data + (length / XXH64_STRIPE_SIZE) * XXH64_STRIPE_SIZE;
+    for (; stripe < end; stripe += XXH64_STRIPE_SIZE) {
+        v1 = xxh64_round(v1, read64(stripe));
+        v2 = xxh64_round(v2, read64(stripe + 8));
+        v3 = xxh64_round(v3, read64(stripe + 16));
+        v4 = xxh64_round(v4, read64(stripe + 24));
+    }
+
+    accumulators[0] = v1;
+    accumulators[1] = v2;
+    accumulators[2] = v3;
+    accumulators[3] = v4;
+    return static_cast<size_t>(stripe - data);
+}
+
+void xxh64_reset(t_xxh64state& state, uint64_t seed)
+{
+    state.totalLength = 0;
+    state.seed = seed;
+    state.accumulators[0] = seed + XXH64_PRIME1 + XXH64_PRIME2;
+    state.accumulators[1] = seed + XXH64_PRIME2;
+    state.accumulators[2] = seed;
+    state.accumulators[3] = seed - XXH64_PRIME1;
+    state.bufferSize = 0;
+}
+
+void xxh64_update(t_xxh64state& state, const void* data, size_t length)
+{
+    const unsigned char* input = static_cast<const unsigned char*>(data);
+    state.totalLength += length;
+
+    // the buffered tail is completed to a stripe first
+    if (state.bufferSize > 0) {
+        const size_t fill = (length < XXH64_STRIPE_SIZE - state.bufferSize) ? length : XXH64_STRIPE_SIZE - state.bufferSize;
+        memcpy(state.buffer + state.bufferSize, input, fill);
+        state.bufferSize += fill;
+        input += fill;
+        length -= fill;
+
+        if (state.bufferSize < XXH64_STRIPE_SIZE)
+            return;
+        xxh64_stripes(state.accumulators, state.buffer, XXH64_STRIPE_SIZE);
+        state.bufferSize = 0;
+    }
+
+    // whole stripes are read in place, large buffers are never copied
+    const size_t consumed = xxh64_stripes(state.accumulators, input, length);
+    memcpy(state.buffer, input + consumed, length - consumed);
+    state.bufferSize = length - consumed;
+}
+
+uint64_t xxh64_digest(const t_xxh64state& state)
+{
+    uint64_t hash;
+    if (state.totalLength >= XXH64_STRIPE_SIZE) {
+        const uint64_t* v = state.accumulators;
+        hash = rotate_left(v[0], 1) + rotate_left(v[1], 7) + rotate_left(v[2], 12) + rotate_left(v[3], 18);
+        hash = xxh64_merge_round(hash, v[0]);
+        hash = xxh64_merge_round(hash, v[1]);
+        hash = xxh64_merge_round(hash, v[2]);
+        hash = xxh64_merge_round(hash, v[3]);
+    }
+    else {
+        hash = state.seed + XXH64_PRIME5;
+    }
+    hash += state.totalLength;
+
+    // the tail: 8 bytes, then 4 bytes, then single bytes
+    const unsigned char* tail = state.buffer;
+    const unsigned char* end = state.buffer + state.bufferSize;
+    for (; tail + 8 <= end; tail += 8) {
+        hash ^= xxh64_round(0, read64(tail));
+        hash = rotate_left(hash, 27) * XXH64_PRIME1 + XXH64_PRIME4;
+    }
+    if (tail + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(tail)) * XXH64_PRIME1;
+        hash = rotate_left(hash, 23) * XXH64_PRIME2 + XXH64_PRIME3;
+        tail += 4;
+    }
+    for (; tail < end; tail++) {
+        hash ^= (*tail) * XXH64_PRIME5;
+        hash = rotate_left(hash, 11) * XXH64_PRIME1;
+    }
+
+    // avalanche
+    hash ^= hash >> 33;
+    hash *= XXH64_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH64_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t xxh64(const void* data, size_t length, uint64_t seed)
+{
+    t_xxh64state state;
+    xxh64_reset(state, seed);
+    xxh64_update(state, data, length);
+    return xxh64_digest(state);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+
+#define XXH64_STRIPE_SIZE   32      // bytes consumed by one round of the four accumulators
+
+
+/**
+Streaming XXH64 state
+The input can be fed in pieces of any size, the digest is the one of the whole input.
+*/
+typedef struct
+{
+    uint64_t        totalLength;                    // bytes fed so far
+    uint64_t        seed;
+    uint64_t        accumulators[4];
+    unsigned char   buffer[XXH64_STRIPE_SIZE];      // tail of the input shorter than a stripe
+    size_t          bufferSize;
+} t_xxh64state;
+
+
+/**
+* Starts a new hash
+*
+* @param state - state to initialise
+* @param seed  - seed of the hash, inputs hashed with different seeds give unrelated digests
+*/
+void xxh64_reset(t_xxh64state& state, uint64_t seed);
+
+/**
+* Hashes the next bytes of the input
+*
+* @param state  - state started by xxh64_reset
+* @param data   - next bytes of the input
+* @param length - bytes in data
+*/
+void xxh64_update(t_xxh64state& state, const void* data, size_t length);
+
+/**
+* Digest of the bytes fed so far, the state is left unchanged and can still be updated
+*/
+uint64_t xxh64_digest(const t_xxh64state& state);
+
+/**
+* XXH64 of one buffer
+*
+* @param data   - bytes to hash
+* @param length - bytes in data
+* @param seed   - seed of the hash
+*/
+uint64_t xxh64(const void* data, size_t length, uint64_t seed);
@@ -0,0 +1,287 @@
+#include "LinearLight.h"
+
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LINEAR_LIGHT_X86    1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa)    __attribute__((target(isa)))
+#endif
+#else
+#define LINEAR_LIGHT_X86    0
+#endif
+
+
+static double srgb_to_linear(double value)
+{
+    return (value <= 0.04045) ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+static double linear_to_srgb_value(double value)
+{
+    return (value <= 0.0031308) ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+}
+
+const t_lineartables& linear_tables()
+{
+    static const t_lineartables tables = []() {
+        t_lineartables newTables;
+        memset(&newTables, 0, sizeof(newTables));
+
+        for (int value = 0; value < 256; value++) {
+            newTables.toLinear[value] = static_cast<uint16_t>(floor(srgb_to_linear(value / 255.0) * 65535.0 + 0.5));
+        }
+        const int steps = 1 << LINEAR_TO_SRGB_BITS;
+        for (int index = 0; index <= steps; index++) {
+            newTables.toSrgb[index] = static_cast<unsigned char>(floor(linear_to_srgb_value(static_cast<double>(index) / steps) * 255.0 + 0.5));
+        }
+        return newTables;
+    }();
+    return tables;
+}
+
+// ======================================================
+// Scalar
+
+template <pixelFormat format>
+static void box_filter_half_linear_row_scalar(const t_lineartables& tables, const unsigned char* inputRow0,
+    const unsigned char* inputRow1, unsigned char* outputRow, int firstPixel, int newWidth)
+{
+    typedef linear_traits<format> traits;
+
+    for (int j = firstPixel; j < newWidth; j++) {
+        const size_t left = static_cast<size_t>(j) * 2 * traits::bytes;
+        const size_t right = left + traits::bytes;
+
+        unsigned int a[traits::channels], b[traits::channels], c[traits::channels], d[traits::channels];
+        traits::load(tables, inputRow0 + left, a);
+        traits::load(tables, inputRow0 + right, b);
+        traits::load(tables, inputRow1 + left, c);
+        traits::load(tables, inputRow1 + right, d);
+
+        unsigned int average[traits::channels];
+        for (size_t chn = 0; chn < traits::channels; chn++) {
+            average[chn] = (a[chn] + b[chn] + c[chn] + d[chn] + 2) >> 2;
+        }
+        traits::store(tables, average, outputRow + static_cast<size_t>(j) * traits::bytes);
+    }
+}
+
+#if LINEAR_LIGHT_X86
+// ======================================================
+// AVX2
+
+// 2 BGRA pixels -> 8 lanes of premultiplied linear light, alpha * 257 in the alpha lanes
+SIMD_TARGET("avx2") static inline __m256i load_linear_bgra_avx2(const t_lineartables& tables, const unsigned char* input)
+{
+    const __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input)));
+    const __m256i linear = _mm256_and_si256(
+        _mm256_i32gather_epi32(reinterpret_cast<const int*>(tables.toLinear), bytes, 2), _mm256_set1_epi32(0xFFFF));
+
+    const __m256i alpha = _mm256_shuffle_epi32(bytes, 0xFF);
+    const __m256i alpha16 = _mm256_mullo_epi32(alpha, _mm256_set1_epi32(257));
+    const __m256i factor = _mm256_add_epi32(alpha16, _mm256_srli_epi32(alpha, 7));
+    const __m256i premultiplied = _mm256_srli_epi32(
+        _mm256_add_epi32(_mm256_mullo_epi32(linear, factor), _mm256_set1_epi32(32768)), 16);
+
+    return _mm256_blend_epi32(premultiplied, alpha16, 0x88);
+}
+
+// 8 lanes of premultiplied linear light -> 2 BGRA pixels
+SIMD_TARGET("avx2") static inline void store_linear_bgra_avx2(const t_lineartables& tables, __m256i channels, unsigned char* output)
+{
+    const __m256i alpha = _mm256_shuffle_epi32(channels, 0xFF);
+
+    // unpremultiply, a fully transparent pixel is black
+    const __m256 linearFloat = _mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(channels), _mm256_set1_ps(65535.0f)),
+        _mm256_cvtepi32_ps(alpha));
+    __m256i linear = _mm256_min_epu32(_mm256_cvtps_epi32(linearFloat), _mm256_set1_epi32(65535));
+    linear = _mm256_andnot_si256(_mm256_cmpeq_epi32(alpha, _mm256_setzero_si256()), linear);
+
+    const __m256i index = _mm256_srli_epi32(
+        _mm256_add_epi32(linear, _mm256_set1_epi32(1 << (LINEAR_LIGHT_BITS - LINEAR_TO_SRGB_BITS - 1))),
+        LINEAR_LIGHT_BITS - LINEAR_TO_SRGB_BITS);
+    const __m256i srgb = _mm256_and_si256(
+        _mm256_i32gather_epi32(reinterpret_cast<const int*>(tables.toSrgb), index, 1), _mm256_set1_epi32(0xFF));
+    const __m256i alpha8 = _mm256_srli_epi32(
+        _mm256_add_epi32(_mm256_mullo_epi32(channels, _mm256_set1_epi32(255)), _mm256_set1_epi32(32895)), 16);
+
+    const __m256i result = _mm256_blend_epi32(srgb, alpha8, 0x88);
+    const __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(result, result), _mm256_setzero_si256());
+    const int first = _mm256_cvtsi256_si32(packed);
+    const int second = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+    memcpy(output, &first, 4);
+    memcpy(output + 4, &second, 4);
+}
+
+SIMD_TARGET("avx2") static int box_filter_half_linear_row_bgra_avx2(const t_lineartables& tables,
+    const unsigned char* inputRow0, const unsigned char* inputRow1, unsigned char* outputRow, int newWidth)
+{
+    int j = 0;
+    for (; j + 2 <= newWidth; j += 2) {
+        const size_t offset = static_cast<size_t>(j) * 8;
+        // source pixels 2j, 2j+1 and 2j+2, 2j+3 of both rows, one pixel per 128 bit lane
+        const __m256i sum0 = _mm256_add_epi32(load_linear_bgra_avx2(tables, inputRow0 + offset),
+                                              load_linear_bgra_avx2(tables, inputRow1 + offset));
+        const __m256i sum1 = _mm256_add_epi32(load_linear_bgra_avx2(tables, inputRow0 + offset + 8),
+                                              load_linear_bgra_avx2(tables, inputRow1 + offset + 8));
+
+        const __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(sum0, sum1, 0x20),
+                                             _mm256_permute2x128_si256(sum0, sum1, 0x31));
+        const __m256i average = _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(2)), 2);
+        store_linear_bgra_avx2(tables, average, outputRow + static_cast<size_t>(j) * 4);
+    }
+    return j;
+}
+#endif
+
+// ======================================================
+
+template <pixelFormat format>
+void box_filter_half_linear_row(const t_lineartables& tables, const unsigned char* inputRow0, const unsigned char* inputRow1,
+    unsigned char* outputRow, int newWidth, simdLevel level)
+{
+    int firstPixel = 0;
+
+#if LINEAR_LIGHT_X86
+    if (PIXELFORMAT_BGRA32 == format && level >= SIMD_AVX2) {
+        firstPixel = box_filter_half_linear_row_bgra_avx2(tables, inputRow0, inputRow1, outputRow, newWidth);
+    }
+#else
+    (void)level;
+#endif
+
+    box_filter_half_linear_row_scalar<format>(tables, inputRow0, inputRow1, outputRow, firstPixel, newWidth);
+}
+
+template <pixelFormat format>
+void box_filter_half_linear(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow)
+{
+    (void)height;
+    (void)newWidth;
+    (void)newHeight;
+
+    const t_lineartables& tables = linear_tables();
+    const simdLevel level = detect_simd_level();
+    const int halfWidth = width / 2;
+
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(originalImagePixelData);
+    unsigned char* output = reinterpret_cast<unsigned char*>(resizedImagePixelData);
+
+    for (int i = firstRow; i < endRow; i++) {
+        const unsigned char* inputRow0 = input + static_cast<size_t>(i * 2 - firstSourceRow) * rowStride;
+        box_filter_half_linear_row<format>(tables, inputRow0, inputRow0 + rowStride,
+            output + static_cast<size_t>(i - firstRow) * newRowStride, halfWidth, level);
+    }
+}
+
+template <pixelFormat format>
+void bilinear_interpolation_linear(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow)
+{
+    typedef linear_traits<format> traits;
+
+    const t_lineartables& tables = linear_tables();
+    const uint64_t one = 1u << BILINEAR_WEIGHT_BITS;
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(originalImagePixelData);
+
+    // byte offsets of the two source pixels and weight of every output column, kept like the plain kernel's
+    static thread_local std::vector<size_t> offsetTable;
+    static thread_local std::vector<int> weightTable;
+    offsetTable.resize(static_cast<size_t>(newWidth) * 2);
+    weightTable.resize(static_cast<size_t>(newWidth));
+    size_t* columnOffsets = offsetTable.data();
+    size_t* nextOffsets = columnOffsets + newWidth;
+    int* columnWeights = weightTable.data();
+
+    for (int j = 0; j < newWidth; j++) {
+        int x, x_next;
+        bilinear_sample(j, width, newWidth, x, x_next, columnWeights[j]);
+        columnOffsets[j] = static_cast<size_t>(x) * traits::bytes;
+        nextOffsets[j] = static_cast<size_t>(x_next) * traits::bytes;
+    }
+
+    for (int i = firstRow; i < endRow; i++) {
+        int y, y_next, y_weight;
+        bilinear_sample(i, height, newHeight, y, y_next, y_weight);
+
+        const unsigned char* inputRowA = input + static_cast<size_t>(y - firstSourceRow) * rowStride;
+        const unsigned char* inputRowC = input + static_cast<size_t>(y_next - firstSourceRow) * rowStride;
+        unsigned char* outputPixel = reinterpret_cast<unsigned char*>(resizedImagePixelData) + static_cast<size_t>(i - firstRow) * newRowStride;
+
+        for (int j = 0; j < newWidth; j++) {
+            unsigned int a[traits::channels], b[traits::channels], c[traits::channels], d[traits::channels];
+            traits::load(tables, inputRowA + columnOffsets[j], a);
+            traits::load(tables, inputRowA + nextOffsets[j], b);
+            traits::load(tables, inputRowC + columnOffsets[j], c);
+            traits::load(tables, inputRowC + nextOffsets[j], d);
+
+            // 16 bit channels with two 11 bit weights need more than 32 bits
+            const uint64_t x_weight = static_cast<uint64_t>(columnWeights[j]);
+            unsigned int blended[traits::channels];
+            for (size_t chn = 0; chn < traits::channels; chn++) {
+                const uint64_t top = a[chn] * (one - x_weight) + b[chn] * x_weight;
+                const uint64_t bottom = c[chn] * (one - x_weight) + d[chn] * x_weight;
+                blended[chn] = static_cast<unsigned int>((top * (one - y_weight) + bottom * y_weight +
+                    (one * one / 2)) >> (2 * BILINEAR_WEIGHT_BITS));
+            }
+            traits::store(tables, blended, outputPixel);
+            outputPixel += traits::bytes;
+        }
+    }
+}
+
+template <pixelFormat format>
+void box_filter_mip_linear(const char* previousLevelPixelData, int width, int height,
+    char* levelPixelData, int firstRow, int endRow)
+{
+    typedef linear_traits<format> traits;
+
+    const t_lineartables& tables = linear_tables();
+    const simdLevel level = detect_simd_level();
+    const int newWidth = (width > 1) ? width / 2 : 1;
+    const size_t rowSize = static_cast<size_t>(width) * traits::bytes;
+    const size_t newRowSize = static_cast<size_t>(newWidth) * traits::bytes;
+
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(previousLevelPixelData);
+    unsigned char* output = reinterpret_cast<unsigned char*>(levelPixelData);
+
+    for (int i = firstRow; i < endRow; i++) {
+        // a single row is averaged with itself, (2a + 2b + 2) / 4 = (a + b + 1) / 2
+        const unsigned char* inputRow0 = input + static_cast<size_t>((height > 1) ? i * 2 : i) * rowSize;
+        const unsigned char* inputRow1 = (height > 1) ? inputRow0 + rowSize : inputRow0;
+        unsigned char* outputRow = output + static_cast<size_t>(i - firstRow) * newRowSize;
+
+        if (width > 1) {
+            box_filter_half_linear_row<format>(tables, inputRow0, inputRow1, outputRow, newWidth, level);
+        }
+        else {
+            unsigned int a[traits::channels], b[traits::channels];
+            traits::load(tables, inputRow0, a);
+            traits::load(tables, inputRow1, b);
+            for (size_t chn = 0; chn < traits::channels; chn++) {
+                a[chn] = (a[chn] + b[chn] + 1) >> 1;
+            }
+            traits::store(tables, a, outputRow);
+        }
+    }
+}
+
+// ======================================================
+// One instance of each kernel per pixel format filtered in linear light
+
+#define LINEAR_LIGHT_INSTANTIATE(format) \
+    template void box_filter_half_linear_row<format>(const t_lineartables&, const unsigned char*, const unsigned char*, \
+        unsigned char*, int, simdLevel); \
+    template void box_filter_half_linear<format>(const char*, int, int, int, size_t, char*, int, int, size_t, int, int); \
+    template void bilinear_interpolation_linear<format>(const char*, int, int, int, size_t, char*, int, int, size_t, int, int); \
+    template void box_filter_mip_linear<format>(const char*, int, int, char*, int, int);
+
+LINEAR_LIGHT_INSTANTIATE(PIXELFORMAT_GREY8)
+LINEAR_LIGHT_INSTANTIATE(PIXELFORMAT_BGR24)
+LINEAR_LIGHT_INSTANTIATE(PIXELFORMAT_BGRA32)
@@ -0,0 +1,150 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "BoxFilter.h"
+#include "Utilities.h"
+
+
+#define LINEAR_LIGHT_BITS       16      // linear light channels are 0 .. (1 << LINEAR_LIGHT_BITS) - 1
+#define LINEAR_TO_SRGB_BITS     12      // index bits of the linear -> sRGB table, every byte survives a round trip
+
+
+/**
+Lookup tables between sRGB bytes and 16 bit linear light
+Both have a few entries of slack at the end so that 32 bit gathers of the last entry stay inside them.
+*/
+typedef struct
+{
+    uint16_t        toLinear[256 + 2];                          // sRGB byte -> linear light, rounded
+    unsigned char   toSrgb[(1 << LINEAR_TO_SRGB_BITS) + 4];     // (linear light + half a step) >> 4 -> sRGB byte, rounded
+} t_lineartables;
+
+
+/**
+* Tables of the sRGB transfer function (IEC 61966-2-1), computed once on the first call
+*/
+const t_lineartables& linear_tables();
+
+/**
+* True for the pixel formats filtered in linear light
+* The 5 bit channels and the 1 bit alpha of PIXELFORMAT_RGB555 are filtered as stored.
+*/
+inline bool linear_light_supported(pixelFormat format)
+{
+    return PIXELFORMAT_RGB555 != format;
+}
+
+/**
+* sRGB byte of a linear light value
+*/
+inline unsigned char linear_to_srgb(const t_lineartables& tables, unsigned int linear)
+{
+    return tables.toSrgb[(linear + (1u << (LINEAR_LIGHT_BITS - LINEAR_TO_SRGB_BITS - 1))) >> (LINEAR_LIGHT_BITS - LINEAR_TO_SRGB_BITS)];
+}
+
+/**
+* Linear light of a premultiplied channel, 0 when the pixel is fully transparent
+* Single precision float: the scalar and the SIMD kernels round the same way.
+*
+* @param premultiplied - premultiplied linear light channel
+* @param alpha         - alpha of the pixel, 0 .. 65535
+*/
+inline unsigned int unpremultiply(unsigned int premultiplied, unsigned int alpha)
+{
+    if (alpha == 0)
+        return 0;
+
+    const float linear = static_cast<float>(premultiplied) * 65535.0f / static_cast<float>(alpha);
+    const long rounded = lrintf(linear);
+    return (rounded > 65535) ? 65535u : static_cast<unsigned int>(rounded);
+}
+
+
+/**
+Pixels as 16 bit linear light channels, with the colour premultiplied by alpha
+load() and store() take the place of pixel_traits::load() and store() in the linear light kernels.
+Alpha is stored as alpha * 257 and premultiplies with alpha * 257 + alpha / 128, so that 255 is exactly 1.0
+and opaque pixels keep their colour.
+*/
+template <pixelFormat format>
+struct linear_traits
+{
+    typedef pixel_traits<format> traits;
+
+    static const size_t bytes = traits::bytes;
+    static const size_t channels = traits::channels;
+    static const bool alpha = (PIXELFORMAT_BGRA32 == format);
+
+    static void load(const t_lineartables& tables, const unsigned char* pixel, unsigned int* channel)
+    {
+        if (!alpha) {
+            for (size_t chn = 0; chn < channels; chn++) {
+                channel[chn] = tables.toLinear[pixel[chn]];
+            }
+            return;
+        }
+
+        const unsigned int factor = pixel[3] * 257u + (pixel[3] >> 7);
+        for (size_t chn = 0; chn < 3; chn++) {
+            channel[chn] = (tables.toLinear[pixel[chn]] * factor + 32768u) >> 16;
+        }
+        channel[3] = pixel[3] * 257u;
+    }
+
+    static void store(const t_lineartables& tables, const unsigned int* channel, unsigned char* pixel)
+    {
+        if (!alpha) {
+            for (size_t chn = 0; chn < channels; chn++) {
+                pixel[chn] = linear_to_srgb(tables, channel[chn]);
+            }
+            return;
+        }
+
+        for (size_t chn = 0; chn < 3; chn++) {
+            pixel[chn] = linear_to_srgb(tables, unpremultiply(channel[chn], channel[3]));
+        }
+        pixel[3] = static_cast<unsigned char>((channel[3] * 255u + 32895u) >> 16);
+    }
+};
+
+
+/**
+* 2x2 box filter in linear light of one output row
+* Same results at every instruction set level, AVX2 gathers cover 32 bit pixels, the other formats are scalar.
+*
+* @param tables     - linear_tables()
+* @param inputRow0  - first source row of the 2x2 blocks
+* @param inputRow1  - second source row of the 2x2 blocks
+* @param outputRow  - destination row holding newWidth pixels
+* @param newWidth   - pixel width of the resized image (source width / 2)
+* @param level      - instruction set to use
+*/
+template <pixelFormat format>
+void box_filter_half_linear_row(const t_lineartables& tables, const unsigned char* inputRow0, const unsigned char* inputRow1,
+    unsigned char* outputRow, int newWidth, simdLevel level);
+
+/**
+* Exact 2x downscale with a 2x2 box filter in linear light, a t_resizekernel
+* Instantiated for the formats of linear_light_supported(), see box_filter_half for the parameters.
+*/
+template <pixelFormat format>
+void box_filter_half_linear(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow);
+
+/**
+* Bilinear interpolation in linear light, a t_resizekernel
+* Same source pixels and weights as bilinear_interpolation_interleaved, see it for the parameters.
+*/
+template <pixelFormat format>
+void bilinear_interpolation_linear(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow);
+
+/**
+* Next mip level with a 2x2 box filter in linear light, a t_mipkernel
+* Same pixels as box_filter_mip, see it for the parameters.
+*/
+template <pixelFormat format>
+void box_filter_mip_linear(const char* previousLevelPixelData, int width, int height,
+    char* levelPixelData, int firstRow, int endRow);
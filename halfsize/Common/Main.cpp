@@ -1,43 +1,517 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include "../TGAProcessing/TGAProcessing.h"
+#include "../Batch/BatchProcessor.h"
+#include "../Server/ResizeServer.h"
 
 
-int main(int argc, char** argv)
+/**
+Command line options shared by all modes
+*/
+typedef struct
 {
-    if (argc != 3)
-    {
-        std::cout << std::endl;
-        std::cout << "Syntax error!" << std::endl << "Pease use: halfsize.exe original.tga half.tga" << std::endl;
-        std::cout << std::endl;
+    size_t          threadCount;
+    bool            rleOutput;
+    bool            linearLight;            // filter in linear light with premultiplied alpha
+    bool            parallelRead;           // single, mips and batch modes: read the pixels in chunks on the pool
+    bool            directIo;               // the same, bypassing the page cache
+    float           scaleFactor;
+    resizeMethod    interpolationMethod;
+    std::string     statsFileName;          // JSON lines appended per image, "-" = standard output, empty = off
+    bool            pipelined;              // batch modes: read, resize and write different images at once
+    std::string     cacheDirectory;         // output cache of the single and batch modes, empty = off
+    size_t          cacheBytes;             // size limit of the output cache
+    bool            hasRegion;              // single mode: only this region of the original is loaded and resized
+    t_region        region;
+    int             newWidth;               // single mode: size of the resized image, 0 = from the scale factor
+    int             newHeight;
+    std::string     socketPath;             // single mode: server the job is sent to, empty = run here
+} t_options;
+
+
+static void print_syntax()
+{
+    std::cout << std::endl;
+    std::cout << "Syntax error!" << std::endl << "Pease use: halfsize.exe [options] [--stream] original.tga half.tga" << std::endl;
+    std::cout << "       or: halfsize.exe [options] --mips|--mips-packed original.tga mip.tga" << std::endl;
+    std::cout << "       or: halfsize.exe [options] [--pipeline] --batch list.txt" << std::endl;
+    std::cout << "       or: halfsize.exe [options] [--pipeline] --batch-dir input_dir output_dir" << std::endl;
+    std::cout << "       or: halfsize.exe [--threads N] [--cache cache_dir] --serve socket" << std::endl;
+    std::cout << "       or: halfsize.exe --connect socket --stop" << std::endl;
+    std::cout << "  options: [--threads N] [--rle] [--linear] [--scale F] [--method nearest|bilinear|box|lanczos3|bicubic|area]" << std::endl;
+    std::cout << "           [--stats stats.jsonl|-] [--cache cache_dir] [--cache-size MB] [--parallel-read] [--direct-io]" << std::endl;
+    std::cout << "           [--region X,Y,W,H] [--size WxH] (single image only)" << std::endl;
+    std::cout << "           [--connect socket] (single image: run on a server, also taken from " SERVER_SOCKET_ENV ")" << std::endl;
+    std::cout << std::endl;
+}
+
+static bool parse_method(const std::string& name, resizeMethod& interpolationMethod)
+{
+    static const struct { const char* name; resizeMethod method; } methods[] = {
+        { "nearest", NEAREST_NEIGHBOR }, { "bilinear", BILINEAR_INTERPOL }, { "box", BOX_FILTER_2X },
+        { "lanczos3", LANCZOS3_FILTER }, { "bicubic", BICUBIC_FILTER }, { "area", AREA_FILTER },
+    };
+
+    for (const auto& entry : methods) {
+        if (name == entry.name) {
+            interpolationMethod = entry.method;
+            return true;
+        }
     }
-    else
-    {
-        TGAProcessing tgaImageProcessing;
+    return false;
+}
 
-        std::cout << "Reading \"" << argv[1] << "\"..." << std::endl;
+static std::string json_string(const std::string& text)
+{
+    std::ostringstream json;
+    json << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            json << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            json << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+        }
+        else {
+            json << c;
+        }
+    }
+    json << '"';
+    return json.str();
+}
+
+/**
+* Appends the stats of one image as a JSON line to options.statsFileName, times in milliseconds
+*
+* @param status - fileStatus of the image, 0 = FILE_OK
+*/
+static void write_stats(const t_options& options, const std::string& inputFileName, const std::string& outputFileName,
+    fileStatus status, const t_tgastats& stats)
+{
+    if (options.statsFileName.empty())
+        return;
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3)
+         << "{\"input\":" << json_string(inputFileName)
+         << ",\"output\":" << json_string(outputFileName)
+         << ",\"status\":" << static_cast<int>(status)
+         << ",\"header_read_ms\":" << stats.headerReadSeconds * 1e3
+         << ",\"payload_read_ms\":" << stats.payloadReadSeconds * 1e3
+         << ",\"deinterleave_ms\":" << stats.deinterleaveSeconds * 1e3
+         << ",\"interpolation_ms\":" << stats.interpolationSeconds * 1e3
+         << ",\"interleave_ms\":" << stats.interleaveSeconds * 1e3
+         << ",\"write_ms\":" << stats.writeSeconds * 1e3
+         << ",\"hash_ms\":" << stats.hashSeconds * 1e3
+         << ",\"bytes_read\":" << stats.bytesRead
+         << ",\"bytes_written\":" << stats.bytesWritten
+         << ",\"allocations\":" << stats.allocations
+         << ",\"peak_buffer_bytes\":" << stats.peakBufferBytes
+         << ",\"cache_hits\":" << stats.cacheHits << "}";
+
+    if (options.statsFileName == "-") {
+        std::cout << line.str() << std::endl;
+        return;
+    }
+
+    std::ofstream statsFile(options.statsFileName, std::ios::out | std::ios::app);
+    statsFile << line.str() << std::endl;
+}
+
+/**
+* Output cache of options.cacheDirectory
+*
+* @return nullptr if no cache is set or the directory cannot be used
+*/
+static std::shared_ptr<OutputCache> open_output_cache(const t_options& options)
+{
+    if (options.cacheDirectory.empty())
+        return nullptr;
 
-        fileStatus result = tgaImageProcessing.LoadImage(std::string(argv[1]));
+    std::shared_ptr<OutputCache> cache = std::make_shared<OutputCache>(options.cacheDirectory, options.cacheBytes);
+    if (!cache->IsOpen()) {
+        std::cout << "Cache directory error, the images are not cached." << std::endl;
+        return nullptr;
+    }
+    return cache;
+}
+
+static int run_single(const std::string& inputFileName, const std::string& outputFileName, const t_options& options)
+{
+    TGAProcessing tgaImageProcessing;
+    tgaImageProcessing.SetThreadCount(options.threadCount);
+    tgaImageProcessing.SetRleOutput(options.rleOutput);
+    tgaImageProcessing.SetLinearLight(options.linearLight);
+    tgaImageProcessing.SetParallelRead(options.parallelRead);
+    tgaImageProcessing.SetDirectIo(options.directIo);
+    tgaImageProcessing.SetStatsEnabled(!options.statsFileName.empty());
+    tgaImageProcessing.SetOutputCache(open_output_cache(options));
+
+    std::cout << "Reading \"" << inputFileName << "\"..." << std::endl;
+
+    fileStatus result = options.hasRegion ? tgaImageProcessing.LoadRegion(inputFileName, options.region)
+                                          : tgaImageProcessing.LoadImage(inputFileName);
+
+    if (FILE_OK == result) {
+        std::cout << "Done" << std::endl;
+
+        std::cout << (options.hasRegion ? "Region size: " : "Original size: ") << std::to_string(tgaImageProcessing.GetWidth())
+                  << "x" << std::to_string(tgaImageProcessing.GetHeight()) << std::endl;
+        int newWidth, newHeight;
+        TGAProcessing::ResizedSize(static_cast<int>(tgaImageProcessing.GetWidth()), static_cast<int>(tgaImageProcessing.GetHeight()),
+            options.scaleFactor, newWidth, newHeight);
+        if (options.newWidth > 0) {
+            newWidth = options.newWidth;
+            newHeight = options.newHeight;
+        }
+        std::cout << "Resizing to: " << std::to_string(newWidth) << "x" << std::to_string(newHeight) << std::endl;
+
+        std::cout << "Saving " << outputFileName << "..." << std::endl;
+
+        if (options.newWidth > 0) {
+            tgaImageProcessing.ResizeImage(newWidth, newHeight, options.interpolationMethod);
+            result = tgaImageProcessing.SaveImage(outputFileName);
+        }
+        else {
+            result = tgaImageProcessing.ResizeImageToFile(outputFileName, options.scaleFactor, options.interpolationMethod);
+        }
 
         if (FILE_OK == result) {
-            std::cout << "Done" << std::endl;
+            std::cout << (tgaImageProcessing.GetStats().cacheHits > 0 ? "Done, from the cache." : "Done.") << std::endl;
+        }
+        else {
+            std::cout << "Image writing error." << std::endl;
+        }
+
+    }
+    else if (FILE_ERR_BAD_REGION == result) {
+        std::cout << "The region is not inside the image." << std::endl;
+    }
+    else {
+        std::cout << "Image reading error." << std::endl;
+    }
+
+    write_stats(options, inputFileName, outputFileName, result, tgaImageProcessing.GetStats());
+    return 0;
+}
+
+/**
+* Sends a single image job to the server of options.socketPath
+*
+* @return false if there is no server or the job needs options it does not take, the job is run here then
+*/
+static bool run_on_server(const std::string& inputFileName, const std::string& outputFileName, const t_options& options)
+{
+    if (options.socketPath.empty() || !options.statsFileName.empty() || options.hasRegion || options.newWidth > 0 ||
+        !options.cacheDirectory.empty() || options.parallelRead)
+        return false;
+
+    t_resizerequest request;
+    request.inputFileName = inputFileName;
+    request.outputFileName = outputFileName;
+    request.scaleFactor = options.scaleFactor;
+    request.interpolationMethod = options.interpolationMethod;
+    request.rleOutput = options.rleOutput;
+    request.linearLight = options.linearLight;
+
+    fileStatus status;
+    double seconds;
+    if (!ResizeServer::Submit(options.socketPath, request, status, seconds))
+        return false;
+
+    if (FILE_OK == status) {
+        std::cout << "Resized \"" << inputFileName << "\" to " << outputFileName << " on the server in " << std::fixed
+                  << std::setprecision(1) << seconds * 1e3 << " ms." << std::endl;
+    }
+    else if (FILE_ERR_BAD_NAME == status) {
+        std::cout << "File names holding a tab or a line break cannot be sent to the server." << std::endl;
+    }
+    else {
+        std::cout << "Image processing error " << static_cast<int>(status) << " on the server." << std::endl;
+    }
+    return true;
+}
+
+static int run_server(const std::string& socketPath, const t_options& options)
+{
+    ResizeServer server(std::make_shared<ThreadPool>(options.threadCount));
+    server.SetOutputCache(open_output_cache(options));
+
+    if (!server.Listen(socketPath)) {
+        std::cout << "Cannot listen on \"" << socketPath << "\", is a server running on it?" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Serving on \"" << socketPath << "\"..." << std::endl;
+    const size_t jobCount = server.Serve();
+    std::cout << "Stopped after " << jobCount << " images." << std::endl;
+    return 0;
+}
+
+static int run_streaming(const std::string& inputFileName, const std::string& outputFileName, const t_options& options)
+{
+    TGAProcessing tgaImageProcessing;
+    tgaImageProcessing.SetThreadCount(options.threadCount);
+    tgaImageProcessing.SetRleOutput(options.rleOutput);
+    tgaImageProcessing.SetLinearLight(options.linearLight);
+    tgaImageProcessing.SetStatsEnabled(!options.statsFileName.empty());
+
+    std::cout << "Resizing \"" << inputFileName << "\" to " << outputFileName << " in bands..." << std::endl;
+
+    fileStatus result = tgaImageProcessing.ResizeImageStreaming(inputFileName, outputFileName, options.scaleFactor,
+        options.interpolationMethod);
 
-            std::cout << "Original size: " << std::to_string(tgaImageProcessing.GetWidth()) << "x" << std::to_string(tgaImageProcessing.GetHeight()) << std::endl;
-            std::cout << "Resizing to: " << std::to_string(tgaImageProcessing.GetWidth() / SCALING_FACTOR) << "x" << std::to_string(tgaImageProcessing.GetHeight() / SCALING_FACTOR) << std::endl;
-        
-            tgaImageProcessing.ResizeImage(SCALING_FACTOR, NEAREST_NEIGHBOR);
+    if (FILE_OK == result) {
+        std::cout << "Done." << std::endl;
+    }
+    else {
+        std::cout << "Image processing error." << std::endl;
+    }
+
+    write_stats(options, inputFileName, outputFileName, result, tgaImageProcessing.GetStats());
+    return 0;
+}
+
+static int run_mips(const std::string& inputFileName, const std::string& outputFileName, const t_options& options, bool packed)
+{
+    TGAProcessing tgaImageProcessing;
+    tgaImageProcessing.SetThreadCount(options.threadCount);
+    tgaImageProcessing.SetRleOutput(options.rleOutput);
+    tgaImageProcessing.SetLinearLight(options.linearLight);
+    tgaImageProcessing.SetParallelRead(options.parallelRead);
+    tgaImageProcessing.SetDirectIo(options.directIo);
+    tgaImageProcessing.SetStatsEnabled(!options.statsFileName.empty());
+
+    std::cout << "Reading \"" << inputFileName << "\"..." << std::endl;
+
+    fileStatus result = tgaImageProcessing.LoadImage(inputFileName);
+    if (FILE_OK != result) {
+        std::cout << "Image reading error." << std::endl;
+        write_stats(options, inputFileName, outputFileName, result, tgaImageProcessing.GetStats());
+        return 1;
+    }
+
+    tgaImageProcessing.BuildMipChain();
+    std::cout << "Saving " << tgaImageProcessing.GetMipLevelCount() << " mip levels to " << outputFileName << "..." << std::endl;
+
+    result = tgaImageProcessing.SaveMipChain(outputFileName, packed);
+    write_stats(options, inputFileName, outputFileName, result, tgaImageProcessing.GetStats());
+    if (FILE_OK != result) {
+        std::cout << "Image writing error." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
+
+static int run_batch(std::vector<t_batchjob>& jobs, const t_options& options)
+{
+    BatchProcessor batchProcessor(std::make_shared<ThreadPool>(options.threadCount));
+    batchProcessor.SetRleOutput(options.rleOutput);
+    batchProcessor.SetLinearLight(options.linearLight);
+    batchProcessor.SetParallelRead(options.parallelRead, options.directIo);
+    batchProcessor.SetStatsEnabled(!options.statsFileName.empty());
+    batchProcessor.SetPipelined(options.pipelined);
+    batchProcessor.SetOutputCache(open_output_cache(options));
+
+    const double seconds = batchProcessor.Run(jobs, options.scaleFactor, options.interpolationMethod);
 
-            std::cout << "Done." << std::endl;
-            std::cout << "Saving " << argv[2] << "..." << std::endl;
+    size_t processedImages = 0;
+    size_t processedBytes = 0;
+    for (const t_batchjob& job : jobs) {
+        // status code as in fileStatus, 0 = FILE_OK
+        std::cout << std::setw(3) << static_cast<int>(job.status) << "  " << job.inputFileName << " -> " << job.outputFileName
+                  << "  " << std::fixed << std::setprecision(1) << job.seconds * 1e3 << " ms"
+                  << (job.stats.cacheHits > 0 ? "  cached" : "") << std::endl;
 
-            tgaImageProcessing.SaveImage(std::string(argv[2]));
+        write_stats(options, job.inputFileName, job.outputFileName, job.status, job.stats);
 
-            std::cout << "Done." << std::endl;
-        
+        if (FILE_OK == job.status) {
+            processedImages++;
+            processedBytes += job.inputBytes;
+        }
+    }
+
+    std::cout << processedImages << "/" << jobs.size() << " images in " << std::setprecision(3) << seconds << " s: "
+              << std::setprecision(1) << static_cast<double>(processedImages) / seconds << " images/s, "
+              << static_cast<double>(processedBytes) / (seconds * 1024.0 * 1024.0) << " MB/s" << std::endl;
+
+    return (processedImages == jobs.size()) ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    t_options options;
+    options.threadCount = 0;
+    options.rleOutput = false;
+    options.linearLight = false;
+    options.parallelRead = false;
+    options.directIo = false;
+    options.scaleFactor = SCALING_FACTOR;
+    options.interpolationMethod = BOX_FILTER_2X;
+    options.pipelined = false;
+    options.cacheBytes = OUTPUT_CACHE_DEFAULT_SIZE;
+    options.hasRegion = false;
+    options.region = t_region();
+    options.newWidth = 0;
+    options.newHeight = 0;
+    if (const char* socketPath = std::getenv(SERVER_SOCKET_ENV)) {
+        options.socketPath = socketPath;
+    }
+
+    bool streaming = false;
+    bool mips = false;
+    bool mipsPacked = false;
+    std::string batchListFileName;
+    bool batchDirectory = false;
+    std::string serveSocketPath;
+    bool stopServer = false;
+    std::vector<std::string> fileNames;
+
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        const std::string arg(argv[argIdx]);
+
+        if (arg == "--threads" && argIdx + 1 < argc) {
+            options.threadCount = static_cast<size_t>(std::strtoul(argv[++argIdx], nullptr, 10));
+        }
+        else if (arg == "--stream") {
+            streaming = true;
+        }
+        else if (arg == "--mips") {
+            mips = true;
+        }
+        else if (arg == "--mips-packed") {
+            mips = true;
+            mipsPacked = true;
+        }
+        else if (arg == "--rle") {
+            options.rleOutput = true;
+        }
+        else if (arg == "--linear") {
+            options.linearLight = true;
+        }
+        else if (arg == "--parallel-read") {
+            options.parallelRead = true;
+        }
+        else if (arg == "--direct-io") {
+            options.parallelRead = true;
+            options.directIo = true;
+        }
+        else if (arg == "--scale" && argIdx + 1 < argc) {
+            options.scaleFactor = std::strtof(argv[++argIdx], nullptr);
+            if (!(options.scaleFactor > 0.0f)) {
+                print_syntax();
+                return 1;
+            }
+        }
+        else if (arg == "--method" && argIdx + 1 < argc) {
+            if (!parse_method(argv[++argIdx], options.interpolationMethod)) {
+                print_syntax();
+                return 1;
+            }
+        }
+        else if (arg == "--batch" && argIdx + 1 < argc) {
+            batchListFileName = argv[++argIdx];
+        }
+        else if (arg == "--stats" && argIdx + 1 < argc) {
+            options.statsFileName = argv[++argIdx];
+        }
+        else if (arg == "--cache" && argIdx + 1 < argc) {
+            options.cacheDirectory = argv[++argIdx];
+        }
+        else if (arg == "--cache-size" && argIdx + 1 < argc) {
+            options.cacheBytes = static_cast<size_t>(std::strtoull(argv[++argIdx], nullptr, 10)) * 1024 * 1024;
+        }
+        else if (arg == "--region" && argIdx + 1 < argc) {
+            t_region& region = options.region;
+            if (sscanf(argv[++argIdx], "%d,%d,%d,%d", &region.x, &region.y, &region.width, &region.height) != 4) {
+                print_syntax();
+                return 1;
+            }
+            options.hasRegion = true;
+        }
+        else if (arg == "--size" && argIdx + 1 < argc) {
+            if (sscanf(argv[++argIdx], "%dx%d", &options.newWidth, &options.newHeight) != 2 ||
+                options.newWidth < 1 || options.newHeight < 1) {
+                print_syntax();
+                return 1;
+            }
+        }
+        else if (arg == "--serve" && argIdx + 1 < argc) {
+            serveSocketPath = argv[++argIdx];
+        }
+        else if (arg == "--connect" && argIdx + 1 < argc) {
+            options.socketPath = argv[++argIdx];
+        }
+        else if (arg == "--stop") {
+            stopServer = true;
+        }
+        else if (arg == "--pipeline") {
+            options.pipelined = true;
+        }
+        else if (arg == "--batch-dir") {
+            batchDirectory = true;
         }
         else {
-            std::cout << "Image reading error." << std::endl;
+            fileNames.push_back(arg);
         }
+    }
 
+    if (!serveSocketPath.empty() && fileNames.empty())
+    {
+        return run_server(serveSocketPath, options);
+    }
+    else if (stopServer && fileNames.empty())
+    {
+        if (options.socketPath.empty() || !ResizeServer::Stop(options.socketPath)) {
+            std::cout << "No server to stop." << std::endl;
+            return 1;
+        }
+        std::cout << "Server stopping." << std::endl;
+        return 0;
+    }
+    else if (!batchListFileName.empty() && fileNames.empty())
+    {
+        std::vector<t_batchjob> jobs;
+        if (!BatchProcessor::ReadListFile(batchListFileName, jobs)) {
+            std::cout << "List file reading error." << std::endl;
+            return 1;
+        }
+        return run_batch(jobs, options);
+    }
+    else if (batchDirectory && fileNames.size() == 2)
+    {
+        std::vector<t_batchjob> jobs;
+        if (!BatchProcessor::ListDirectory(fileNames[0], fileNames[1], jobs)) {
+            std::cout << "Directory reading error." << std::endl;
+            return 1;
+        }
+        return run_batch(jobs, options);
+    }
+    else if (fileNames.size() != 2 || batchDirectory || !batchListFileName.empty())
+    {
+        print_syntax();
+    }
+    else if (mips)
+    {
+        return run_mips(fileNames[0], fileNames[1], options, mipsPacked);
+    }
+    else if (streaming)
+    {
+        return run_streaming(fileNames[0], fileNames[1], options);
+    }
+    else if (run_on_server(fileNames[0], fileNames[1], options))
+    {
+        return 0;
+    }
+    else
+    {
+        return run_single(fileNames[0], fileNames[1], options);
     }
 
     return 0;
@@ -0,0 +1,212 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : data(nullptr), size(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+{
+}
+
+bool MappedFile::OpenRead(const std::string& fileName)
+{
+    Close();
+
+    fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        Close();
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr) {
+        Close();
+        return false;
+    }
+
+    data = static_cast<char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr) {
+        Close();
+        return false;
+    }
+
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+bool MappedFile::CreateWrite(const std::string& fileName, size_t newSize)
+{
+    Close();
+
+    if (newSize == 0)
+        return false;
+
+    fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    const unsigned long long mappingSize = newSize;
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize & 0xFFFFFFFFull), nullptr);
+    if (mappingHandle == nullptr) {
+        Close();
+        return false;
+    }
+
+    data = static_cast<char*>(MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, newSize));
+    if (data == nullptr) {
+        Close();
+        return false;
+    }
+
+    size = newSize;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile()
+    : data(nullptr), size(0), fileDescriptor(-1)
+{
+}
+
+bool MappedFile::OpenRead(const std::string& fileName)
+{
+    Close();
+
+    fileDescriptor = open(fileName.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        return false;
+
+    struct stat fileInfo;
+    if (fstat(fileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0) {
+        Close();
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        Close();
+        return false;
+    }
+
+    data = static_cast<char*>(mapping);
+    size = static_cast<size_t>(fileInfo.st_size);
+
+    // the resize kernels walk the source rows front to back
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool MappedFile::CreateWrite(const std::string& fileName, size_t newSize)
+{
+    Close();
+
+    if (newSize == 0)
+        return false;
+
+    fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0)
+        return false;
+
+    if (ftruncate(fileDescriptor, static_cast<off_t>(newSize)) != 0) {
+        Close();
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        Close();
+        return false;
+    }
+
+    data = static_cast<char*>(mapping);
+    size = newSize;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr)
+        munmap(data, size);
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+
+    data = nullptr;
+    size = 0;
+    fileDescriptor = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length)
+{
+    if (data == nullptr || offset >= size)
+        return;
+    if (length > size - offset) {
+        length = size - offset;
+    }
+
+#if !defined(_WIN32) && defined(MADV_POPULATE_READ)
+    // one call reads the pages and maps them, the mapping has to start on a page
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t first = offset - offset % pageSize;
+    if (madvise(data + first, length + (offset - first), MADV_POPULATE_READ) == 0)
+        return;
+#endif
+
+    // older kernels and Windows: one read per page faults it in
+    volatile const char* bytes = data + offset;
+    unsigned char sum = 0;
+    for (size_t byte = 0; byte < length; byte += MAPPED_FILE_PAGE_SIZE) {
+        sum = static_cast<unsigned char>(sum + bytes[byte]);
+    }
+    (void)sum;
+}
+
+char* MappedFile::GetData() const
+{
+    return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return size;
+}
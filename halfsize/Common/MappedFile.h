@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+
+#define MAPPED_FILE_PAGE_SIZE   4096    // smallest page size, Prefetch() touches every page at least once
+
+/**
+Memory-mapped file
+Read-only mapping of an existing file, or a read/write mapping of a new file of a given size.
+The mapping is released on Close() or destruction.
+*/
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+    * Maps an existing file read-only
+    *
+    * @param fileName - path of the file
+    * @return true if the whole file is mapped
+    */
+    bool OpenRead(const std::string& fileName);
+
+    /**
+    * Creates (or truncates) a file of the given size and maps it read/write
+    *
+    * @param fileName - path of the file
+    * @param size     - file size in bytes
+    * @return true if the whole file is mapped
+    */
+    bool CreateWrite(const std::string& fileName, size_t size);
+
+    /**
+    * Reads a range of a read-only mapping into memory now instead of on first access
+    * Used when the mapping is read on another thread than the one loading it, e.g. by a pipeline
+    *
+    * @param offset - first byte of the range
+    * @param length - bytes in the range, clamped to the end of the file
+    */
+    void Prefetch(size_t offset, size_t length);
+
+    void Close();
+
+    char*   GetData() const;
+    size_t  GetSize() const;
+
+private:
+    char*   data;
+    size_t  size;
+
+#ifdef _WIN32
+    void*   fileHandle;
+    void*   mappingHandle;
+#else
+    int     fileDescriptor;
+#endif
+};
@@ -0,0 +1,354 @@
+#include "OutputCache.h"
+#include "OutputFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#endif
+
+
+#define OUTPUT_CACHE_KEY_DIGITS     16      // hex digits of a key in an entry file name
+
+
+/**
+Entry found in the cache directory when it is opened
+*/
+typedef struct
+{
+    uint64_t    key;
+    size_t      bytes;
+    time_t      modified;
+} t_diskentry;
+
+
+// Key of an entry file name, false for the other files of the directory
+static bool parse_entry_name(const std::string& name, uint64_t& key)
+{
+    const std::string extension(OUTPUT_CACHE_EXTENSION);
+    if (name.size() != OUTPUT_CACHE_KEY_DIGITS + extension.size() ||
+        name.compare(OUTPUT_CACHE_KEY_DIGITS, std::string::npos, extension) != 0)
+        return false;
+
+    key = 0;
+    for (size_t i = 0; i < OUTPUT_CACHE_KEY_DIGITS; i++) {
+        const char c = name[i];
+        int digit;
+        if (c >= '0' && c <= '9')      digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else                           return false;
+        key = (key << 4) | static_cast<uint64_t>(digit);
+    }
+    return true;
+}
+
+// Sets the modification time of a file to now, it orders the entries when the cache is opened again
+static void touch_file(const std::string& fileName)
+{
+#ifdef _WIN32
+    _utime(fileName.c_str(), nullptr);
+#else
+    utime(fileName.c_str(), nullptr);
+#endif
+}
+
+static bool copy_file(const std::string& source, const std::string& target)
+{
+    std::ifstream input(source, std::ios::in | std::ios::binary);
+    if (!input.is_open())
+        return false;
+    std::ofstream output(target, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!output.is_open())
+        return false;
+
+    output << input.rdbuf();
+    output.close();
+    if (output.fail()) {
+        std::remove(target.c_str());
+        return false;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+static bool create_directory(const std::string& directory)
+{
+    return CreateDirectoryA(directory.c_str(), nullptr) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+static bool list_entries(const std::string& directory, std::vector<t_diskentry>& found)
+{
+    WIN32_FIND_DATAA findData;
+    HANDLE findHandle = FindFirstFileA((directory + "\\*" OUTPUT_CACHE_EXTENSION).c_str(), &findData);
+    if (findHandle == INVALID_HANDLE_VALUE)
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+
+    do {
+        t_diskentry entry;
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && parse_entry_name(findData.cFileName, entry.key)) {
+            entry.bytes = (static_cast<size_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+            // FILETIME ticks, only the order matters
+            entry.modified = static_cast<time_t>((static_cast<uint64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) |
+                findData.ftLastWriteTime.dwLowDateTime);
+            found.push_back(entry);
+        }
+    } while (FindNextFileA(findHandle, &findData));
+
+    FindClose(findHandle);
+    return true;
+}
+
+static size_t file_size(const std::string& fileName)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(fileName.c_str(), GetFileExInfoStandard, &attributes))
+        return 0;
+    return (static_cast<size_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
+
+static bool clone_file(const std::string&, const std::string&, bool&)
+{
+    return false;
+}
+
+#else
+
+static bool create_directory(const std::string& directory)
+{
+    struct stat status;
+    return mkdir(directory.c_str(), 0755) == 0 || (stat(directory.c_str(), &status) == 0 && S_ISDIR(status.st_mode));
+}
+
+static bool list_entries(const std::string& directory, std::vector<t_diskentry>& found)
+{
+    DIR* directoryStream = opendir(directory.c_str());
+    if (directoryStream == nullptr)
+        return false;
+
+    while (const dirent* directoryEntry = readdir(directoryStream)) {
+        t_diskentry entry;
+        struct stat status;
+        if (parse_entry_name(directoryEntry->d_name, entry.key) &&
+            stat((directory + "/" + directoryEntry->d_name).c_str(), &status) == 0 && S_ISREG(status.st_mode)) {
+            entry.bytes = static_cast<size_t>(status.st_size);
+            entry.modified = status.st_mtime;
+            found.push_back(entry);
+        }
+    }
+
+    closedir(directoryStream);
+    return true;
+}
+
+static size_t file_size(const std::string& fileName)
+{
+    struct stat status;
+    if (stat(fileName.c_str(), &status) != 0)
+        return 0;
+    return static_cast<size_t>(status.st_size);
+}
+
+// Copy-on-write clone, unsupported is set when the filesystem has no reflinks
+static bool clone_file(const std::string& source, const std::string& target, bool& unsupported)
+{
+#ifdef FICLONE
+    const int sourceDescriptor = open(source.c_str(), O_RDONLY);
+    if (sourceDescriptor < 0)
+        return false;
+
+    bool cloned = false;
+    const int targetDescriptor = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (targetDescriptor >= 0) {
+        cloned = ioctl(targetDescriptor, FICLONE, sourceDescriptor) == 0;
+        unsupported = !cloned && (errno == EOPNOTSUPP || errno == ENOTTY || errno == EINVAL || errno == EXDEV);
+        close(targetDescriptor);
+        if (!cloned) {
+            unlink(target.c_str());
+        }
+    }
+    close(sourceDescriptor);
+    return cloned;
+#else
+    (void)source;
+    (void)target;
+    unsupported = true;
+    return false;
+#endif
+}
+
+#endif
+
+// ======================================================
+
+OutputCache::OutputCache(const std::string& cacheDirectory, size_t maxCacheBytes)
+    : directory(cacheDirectory), maxBytes(maxCacheBytes), isOpen(false), tryReflink(true), totalBytes(0)
+{
+    std::vector<t_diskentry> found;
+    isOpen = create_directory(directory) && list_entries(directory, found);
+
+    // the most recently used entries, i.e. modified, come first
+    std::stable_sort(found.begin(), found.end(),
+        [](const t_diskentry& a, const t_diskentry& b) { return a.modified > b.modified; });
+
+    for (const t_diskentry& entry : found) {
+        entries.push_back({ entry.key, entry.bytes, 0 });
+        index[entry.key] = std::prev(entries.end());
+        totalBytes += entry.bytes;
+    }
+
+    // a smaller limit than in the previous run applies straight away
+    Evict();
+}
+
+bool OutputCache::IsOpen() const
+{
+    return isOpen;
+}
+
+bool OutputCache::Contains(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.find(key) != index.end();
+}
+
+bool OutputCache::Fetch(uint64_t key, const std::string& fileName)
+{
+    std::list<t_cacheentry>::iterator entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(key);
+        if (found == index.end())
+            return false;
+        entry = found->second;
+        entry->pins++;
+    }
+
+    // cloned next to the output and renamed over it, the old output is replaced and never written through
+    const std::string entryFileName = EntryFileName(key);
+    std::string temporaryFileName;
+    OutputFile output(fileName, temporaryFileName);
+    const bool fetched = CloneFile(entryFileName, temporaryFileName) && output.Commit();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entry->pins--;
+    if (fetched) {
+        touch_file(entryFileName);
+        entries.splice(entries.begin(), entries, entry);
+    }
+    else if (entry->pins == 0 && file_size(entryFileName) == 0) {
+        // the entry was removed from the directory behind the cache's back, else the output path is not writable
+        totalBytes -= entry->bytes;
+        index.erase(key);
+        entries.erase(entry);
+    }
+
+    // an eviction the pin held back
+    Evict();
+    return fetched;
+}
+
+void OutputCache::Store(uint64_t key, const std::string& fileName)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!isOpen || index.find(key) != index.end() || !storing.insert(key).second)
+            return;
+    }
+
+    // entries appear whole, under their name, or not at all
+    const std::string entryFileName = EntryFileName(key);
+    std::string temporaryFileName;
+    bool stored;
+    {
+        OutputFile entry(entryFileName, temporaryFileName);
+        stored = CloneFile(fileName, temporaryFileName) && entry.Commit();
+    }
+    const size_t bytes = stored ? file_size(entryFileName) : 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    storing.erase(key);
+    if (!stored)
+        return;
+
+    entries.push_front({ key, bytes, 0 });
+    index[key] = entries.begin();
+    totalBytes += bytes;
+
+    Evict();
+}
+
+size_t OutputCache::GetSize()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalBytes;
+}
+
+size_t OutputCache::GetEntryCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+std::string OutputCache::EntryFileName(uint64_t key) const
+{
+    char name[OUTPUT_CACHE_KEY_DIGITS + 1];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+#ifdef _WIN32
+    return directory + "\\" + name + OUTPUT_CACHE_EXTENSION;
+#else
+    return directory + "/" + name + OUTPUT_CACHE_EXTENSION;
+#endif
+}
+
+// Reflink, else copy; target must not exist
+// Never a hardlink: an entry and an output sharing one inode would let any write to the output, by halfsize
+// or another tool, change the entry, and touching the entry on a hit would change the output's mtime
+bool OutputCache::CloneFile(const std::string& source, const std::string& target)
+{
+    if (tryReflink) {
+        bool unsupported = false;
+        if (clone_file(source, target, unsupported))
+            return true;
+        if (unsupported) {
+            tryReflink = false;
+        }
+    }
+    return copy_file(source, target);
+}
+
+// Called with the mutex held, pinned entries are skipped until their last Fetch() is done
+void OutputCache::Evict()
+{
+    auto oldest = entries.end();
+    while (totalBytes > maxBytes && oldest != entries.begin()) {
+        --oldest;
+        if (oldest->pins > 0)
+            continue;
+
+        std::remove(EntryFileName(oldest->key).c_str());
+        totalBytes -= oldest->bytes;
+        index.erase(oldest->key);
+        oldest = entries.erase(oldest);
+    }
+}
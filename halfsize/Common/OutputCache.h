@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+
+#define OUTPUT_CACHE_DEFAULT_SIZE   (1024ull * 1024 * 1024)     // bytes kept when no size limit is given
+#define OUTPUT_CACHE_EXTENSION      ".tga"
+
+
+/**
+Content-addressed cache of resized images
+Each entry is a file of the cache directory named by its 64 bit key in hex, the key being a hash of the
+original image and of everything the resized image depends on. Fetch() puts a cached image at the output
+path as a reflink (copy-on-write clone) where the filesystem has them, else as a copy, and Store() adds an
+output the same way. Entries and outputs never share an inode, so writing to an output cannot change an entry.
+The entries over the size limit are removed least recently used first. Recency survives between runs in
+the modification time of the entries, which a hit updates.
+Safe to share between the threads of one process. The lock only covers the index: files are cloned or copied
+without it, and an entry being copied out is pinned, its removal waits until the copy is done.
+*/
+class OutputCache
+{
+public:
+    /**
+    * Opens a cache directory, creating it when missing, and indexes the entries found in it
+    *
+    * @param directory - folder of the entries
+    * @param maxBytes  - size limit of the entries
+    */
+    OutputCache(const std::string& directory, size_t maxBytes);
+
+    OutputCache(const OutputCache&) = delete;
+    OutputCache& operator=(const OutputCache&) = delete;
+
+    /**
+    * @return false if the directory could not be created or read, nothing is cached then
+    */
+    bool IsOpen() const;
+
+    bool Contains(uint64_t key);
+
+    /**
+    * Puts the cached image of a key at fileName, replacing the file there
+    *
+    * @param key      - key of the image
+    * @param fileName - output path
+    * @return false on a miss, fileName is left untouched then
+    */
+    bool Fetch(uint64_t key, const std::string& fileName);
+
+    /**
+    * Adds a written image to the cache and evicts the least recently used entries over the size limit
+    *
+    * @param key      - key of the image
+    * @param fileName - path of the image, it is not changed
+    */
+    void Store(uint64_t key, const std::string& fileName);
+
+    size_t GetSize();
+    size_t GetEntryCount();
+
+private:
+    typedef struct
+    {
+        uint64_t    key;
+        size_t      bytes;
+        int         pins;       // Fetch() calls copying the entry out, it is not removed while they run
+    } t_cacheentry;
+
+    std::string directory;
+    size_t      maxBytes;
+    bool        isOpen;
+    std::atomic<bool> tryReflink;   // cleared by the first filesystem without reflinks
+
+    std::mutex  mutex;
+    size_t      totalBytes;
+    std::list<t_cacheentry> entries;    // most recently used first
+    std::unordered_map<uint64_t, std::list<t_cacheentry>::iterator> index;
+    std::unordered_set<uint64_t> storing;   // keys being copied in by Store()
+
+    std::string EntryFileName(uint64_t key) const;
+    bool CloneFile(const std::string& source, const std::string& target);
+    void Evict();
+};
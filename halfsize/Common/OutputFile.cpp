@@ -0,0 +1,60 @@
+#include "OutputFile.h"
+
+#include <atomic>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+
+// Unique between the outputs of all threads and processes writing to the same folder
+static void temporary_name(const std::string& fileName, std::string& temporaryFileName)
+{
+    static std::atomic<unsigned long> counter(0);
+#ifdef _WIN32
+    const long processId = static_cast<long>(_getpid());
+#else
+    const long processId = static_cast<long>(getpid());
+#endif
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%ld.%lu" OUTPUT_FILE_SUFFIX, processId, counter++);
+
+    // assign() and append() keep the capacity of the string
+    temporaryFileName.assign(fileName);
+    temporaryFileName.append(suffix);
+}
+
+OutputFile::OutputFile(const std::string& outputFileName, std::string& temporaryName)
+    : fileName(outputFileName), temporaryFileName(temporaryName), committed(false)
+{
+    temporary_name(fileName, temporaryFileName);
+}
+
+OutputFile::~OutputFile()
+{
+    if (!committed) {
+        std::remove(temporaryFileName.c_str());
+    }
+}
+
+const std::string& OutputFile::GetTemporaryName() const
+{
+    return temporaryFileName;
+}
+
+bool OutputFile::Commit()
+{
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    committed = MoveFileExA(temporaryFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    committed = std::rename(temporaryFileName.c_str(), fileName.c_str()) == 0;
+#endif
+    return committed;
+}
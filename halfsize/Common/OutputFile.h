@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+
+
+#define OUTPUT_FILE_SUFFIX      ".tmp"      // temporary name: output path, process id, counter and this suffix
+
+/**
+Output file written under a temporary name in its folder and renamed over its path once complete
+The file at the path is replaced, never written in place: it may be the input that is still being read,
+e.g. memory-mapped, or another link of a cached image. Readers see the old file or the new one, never a
+part of it. The temporary file is removed if the output is not committed.
+The temporary name is built in a string kept by the caller, which allocates nothing once it is long enough.
+*/
+class OutputFile
+{
+public:
+    /**
+    * @param fileName          - final path of the output, must outlive the OutputFile
+    * @param temporaryFileName - receives the temporary name, reused from output to output
+    */
+    OutputFile(const std::string& fileName, std::string& temporaryFileName);
+    ~OutputFile();
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    /**
+    * @return path to write the output to, in the folder of the final path
+    */
+    const std::string& GetTemporaryName() const;
+
+    /**
+    * Renames the written temporary file over the final path
+    *
+    * @return true if the output is at its final path
+    */
+    bool Commit();
+
+private:
+    const std::string&  fileName;
+    std::string&        temporaryFileName;
+    bool                committed;
+};
@@ -0,0 +1,376 @@
+#include "Resampler.h"
+
+#include <algorithm>
+
+#include "LinearLight.h"
+
+
+#define RESAMPLE_PI     3.14159265358979323846
+
+
+// ======================================================
+// Filter kernels, x in source pixels (scaled by the downscale factor when shrinking)
+
+static double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= RESAMPLE_PI;
+    return sin(x) / x;
+}
+
+static double lanczos3_filter(double x)
+{
+    if (x > -3.0 && x < 3.0)
+        return sinc(x) * sinc(x / 3.0);
+    return 0.0;
+}
+
+// Keys cubic convolution, a = -0.5
+static double bicubic_filter(double x)
+{
+    const double a = -0.5;
+    x = fabs(x);
+    if (x < 1.0)
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+    if (x < 2.0)
+        return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+    return 0.0;
+}
+
+// Part of the source pixel s, [s, s + 1), covered by the output pixel footprint [begin, end)
+static double area_weight(int s, double begin, double end)
+{
+    const double covered = std::min(s + 1.0, end) - std::max(static_cast<double>(s), begin);
+    return (covered > 0.0) ? covered : 0.0;
+}
+
+static double filter_support(resizeMethod interpolationMethod)
+{
+    return (LANCZOS3_FILTER == interpolationMethod) ? 3.0 : 2.0;
+}
+
+static double filter_weight(resizeMethod interpolationMethod, double x)
+{
+    return (LANCZOS3_FILTER == interpolationMethod) ? lanczos3_filter(x) : bicubic_filter(x);
+}
+
+/**
+* Computes the taps of one axis
+* Pixel centres are aligned, (i + 0.5) * ratio, and the filter is widened by the ratio when shrinking
+* The area filter weighs each source pixel by the part of it the output pixel [i * ratio, (i + 1) * ratio)
+* covers, which takes at most ceil(ratio) + 1 pixels
+* Weights falling outside the image are dropped and the remaining ones normalized
+*/
+static void compute_taps(resizeMethod interpolationMethod, int size, int newSize, t_resampletaps& taps)
+{
+    const double ratio = static_cast<double>(size) / static_cast<double>(newSize);
+    const double filterScale = (ratio > 1.0) ? ratio : 1.0;
+    const bool area = (AREA_FILTER == interpolationMethod);
+    const double support = area ? 0.0 : filter_support(interpolationMethod) * filterScale;
+
+    taps.taps = area ? static_cast<int>(ceil(ratio)) + 1 : static_cast<int>(ceil(support)) * 2 + 1;
+    if (taps.taps > size) {
+        taps.taps = size;
+    }
+    // the vectors keep their capacity when the taps are computed again
+    taps.first.resize(newSize);
+    taps.weights.assign(static_cast<size_t>(newSize) * taps.taps, 0);
+
+    static thread_local std::vector<double> weights;
+    weights.resize(taps.taps);
+
+    for (int i = 0; i < newSize; i++) {
+        const double center = (i + 0.5) * ratio;
+        const double begin = i * ratio;
+        const double end = (i + 1) * ratio;
+        const int sourceMin = area ? static_cast<int>(begin) : std::max(static_cast<int>(center - support + 0.5), 0);
+        const int sourceLimit = area ? static_cast<int>(ceil(end)) : static_cast<int>(center + support + 0.5);
+        const int sourceEnd = std::min(std::min(sourceLimit, size), sourceMin + taps.taps);
+
+        // all taps must lie inside the image, near the right edge the window is moved left
+        const int first = std::min(sourceMin, size - taps.taps);
+        taps.first[i] = first;
+
+        double total = 0.0;
+        std::fill(weights.begin(), weights.end(), 0.0);
+        for (int s = sourceMin; s < sourceEnd; s++) {
+            const double weight = area ? area_weight(s, begin, end)
+                                       : filter_weight(interpolationMethod, (s - center + 0.5) / filterScale);
+            weights[s - first] = weight;
+            total += weight;
+        }
+        if (total == 0.0) {
+            // nothing under the filter: nearest source pixel
+            const int nearest = std::min(static_cast<int>(center), size - 1);
+            weights[nearest - first] = 1.0;
+            total = 1.0;
+        }
+
+        // fixed point, the rounding error is put on the largest weight so flat areas stay flat
+        short* fixedWeights = &taps.weights[static_cast<size_t>(i) * taps.taps];
+        int fixedTotal = 0;
+        int largest = 0;
+        for (int t = 0; t < taps.taps; t++) {
+            fixedWeights[t] = static_cast<short>(floor(weights[t] / total * (1 << RESAMPLE_WEIGHT_BITS) + 0.5));
+            fixedTotal += fixedWeights[t];
+            if (fixedWeights[t] > fixedWeights[largest]) {
+                largest = t;
+            }
+        }
+        fixedWeights[largest] = static_cast<short>(fixedWeights[largest] + (1 << RESAMPLE_WEIGHT_BITS) - fixedTotal);
+    }
+}
+
+static inline unsigned int clamp_channel(int sum, unsigned int maxValue)
+{
+    sum = (sum + (1 << (RESAMPLE_WEIGHT_BITS - 1))) >> RESAMPLE_WEIGHT_BITS;
+    return (sum < 0) ? 0u : (static_cast<unsigned int>(sum) > maxValue) ? maxValue : static_cast<unsigned int>(sum);
+}
+
+static inline unsigned int clamp_linear(int64_t sum)
+{
+    sum = (sum + (1 << (RESAMPLE_WEIGHT_BITS - 1))) >> RESAMPLE_WEIGHT_BITS;
+    return (sum < 0) ? 0u : (sum > 65535) ? 65535u : static_cast<unsigned int>(sum);
+}
+
+// Horizontal pass of one row into channels of one byte, the channel loop is unrolled for each pixel format
+template <pixelFormat format>
+static void resample_row(const unsigned char* inputRow, unsigned char* outputRow, const t_resampletaps& taps, int newWidth)
+{
+    typedef pixel_traits<format> traits;
+
+    for (int j = 0; j < newWidth; j++) {
+        const unsigned char* inputPixel = inputRow + static_cast<size_t>(taps.first[j]) * traits::bytes;
+        const short* weights = &taps.weights[static_cast<size_t>(j) * taps.taps];
+
+        int sum[traits::channels] = {};
+        for (int t = 0; t < taps.taps; t++) {
+            unsigned int channel[traits::channels];
+            traits::load(inputPixel, channel);
+            for (size_t chn = 0; chn < traits::channels; chn++) {
+                sum[chn] += weights[t] * static_cast<int>(channel[chn]);
+            }
+            inputPixel += traits::bytes;
+        }
+        for (size_t chn = 0; chn < traits::channels; chn++) {
+            outputRow[chn] = static_cast<unsigned char>(clamp_channel(sum[chn], traits::max_value(chn)));
+        }
+        outputRow += traits::channels;
+    }
+}
+
+// Horizontal pass of one row into 16 bit premultiplied linear light channels
+template <pixelFormat format>
+static void resample_row_linear(const t_lineartables& tables, const unsigned char* inputRow, uint16_t* outputRow,
+    const t_resampletaps& taps, int newWidth)
+{
+    typedef linear_traits<format> traits;
+
+    for (int j = 0; j < newWidth; j++) {
+        const unsigned char* inputPixel = inputRow + static_cast<size_t>(taps.first[j]) * traits::bytes;
+        const short* weights = &taps.weights[static_cast<size_t>(j) * taps.taps];
+
+        // 16 bit channels times 14 bit weights, the negative lobes can push a sum past 31 bits
+        int64_t sum[traits::channels] = {};
+        for (int t = 0; t < taps.taps; t++) {
+            unsigned int channel[traits::channels];
+            traits::load(tables, inputPixel, channel);
+            for (size_t chn = 0; chn < traits::channels; chn++) {
+                sum[chn] += static_cast<int64_t>(weights[t]) * channel[chn];
+            }
+            inputPixel += traits::bytes;
+        }
+        for (size_t chn = 0; chn < traits::channels; chn++) {
+            outputRow[chn] = static_cast<uint16_t>(clamp_linear(sum[chn]));
+        }
+        outputRow += traits::channels;
+    }
+}
+
+// ======================================================
+
+Resampler::Resampler(resizeMethod interpolationMethod, int width, int height, int newWidth, int newHeight, pixelFormat format,
+    bool linearLight)
+{
+    Configure(interpolationMethod, width, height, newWidth, newHeight, format, linearLight);
+}
+
+void Resampler::Configure(resizeMethod newMethod, int newSourceWidth, int newSourceHeight, int newResizedWidth,
+    int newResizedHeight, pixelFormat newFormat, bool newLinearLight)
+{
+    interpolationMethod = newMethod;
+    width = newSourceWidth;
+    height = newSourceHeight;
+    newWidth = newResizedWidth;
+    newHeight = newResizedHeight;
+    format = newFormat;
+    linearLight = newLinearLight && linear_light_supported(format);
+
+    // the passes of the format are picked here, Resize() does not look at the format again
+    switch (format) {
+    case PIXELFORMAT_GREY8:
+        resizeRows = linearLight ? &Resampler::ResizeRowsLinear<PIXELFORMAT_GREY8> : &Resampler::ResizeRows<PIXELFORMAT_GREY8>;
+        break;
+    case PIXELFORMAT_RGB555:
+        resizeRows = &Resampler::ResizeRows<PIXELFORMAT_RGB555>;
+        break;
+    case PIXELFORMAT_BGR24:
+        resizeRows = linearLight ? &Resampler::ResizeRowsLinear<PIXELFORMAT_BGR24> : &Resampler::ResizeRows<PIXELFORMAT_BGR24>;
+        break;
+    default:
+        resizeRows = linearLight ? &Resampler::ResizeRowsLinear<PIXELFORMAT_BGRA32> : &Resampler::ResizeRows<PIXELFORMAT_BGRA32>;
+        break;
+    }
+
+    compute_taps(interpolationMethod, width, newWidth, horizontalTaps);
+    compute_taps(interpolationMethod, height, newHeight, verticalTaps);
+}
+
+bool Resampler::Matches(resizeMethod otherMethod, int otherWidth, int otherHeight, int otherNewWidth, int otherNewHeight,
+    pixelFormat otherFormat, bool otherLinearLight) const
+{
+    return interpolationMethod == otherMethod && width == otherWidth && height == otherHeight &&
+           newWidth == otherNewWidth && newHeight == otherNewHeight && format == otherFormat &&
+           linearLight == (otherLinearLight && linear_light_supported(otherFormat));
+}
+
+bool Resampler::IsSeparable(resizeMethod interpolationMethod)
+{
+    return LANCZOS3_FILTER == interpolationMethod || BICUBIC_FILTER == interpolationMethod ||
+           AREA_FILTER == interpolationMethod;
+}
+
+void Resampler::SourceRows(int firstRow, int endRow, int& firstSourceRow, int& lastSourceRow) const
+{
+    // the first tap only moves down the image from one output row to the next
+    firstSourceRow = verticalTaps.first[firstRow];
+    lastSourceRow = verticalTaps.first[endRow - 1] + verticalTaps.taps - 1;
+}
+
+void Resampler::Resize(const char* originalPixels, int firstSourceRow, size_t rowStride, char* resizedPixels, size_t newRowStride,
+    int firstRow, int endRow) const
+{
+    (this->*resizeRows)(originalPixels, firstSourceRow, rowStride, resizedPixels, newRowStride, firstRow, endRow);
+}
+
+template <pixelFormat pixelFormatOfRows>
+void Resampler::ResizeRows(const char* originalPixels, int firstSourceRow, size_t rowStride, char* resizedPixels, size_t newRowStride,
+    int firstRow, int endRow) const
+{
+    typedef pixel_traits<pixelFormatOfRows> traits;
+
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(originalPixels);
+    unsigned char* output = reinterpret_cast<unsigned char*>(resizedPixels);
+
+    // the buffered rows hold one byte per channel, 16 bit pixels are unpacked by the horizontal pass
+    const size_t newRowSize = static_cast<size_t>(newWidth) * traits::bytes;
+    const size_t bufferRowSize = static_cast<size_t>(newWidth) * traits::channels;
+
+    int bandFirst, bandLast;
+    SourceRows(firstRow, endRow, bandFirst, bandLast);
+
+    // Buffers of the thread running the band, kept for its next band
+    static thread_local std::vector<unsigned char> rowBuffer;
+    static thread_local std::vector<int> sum;
+    rowBuffer.resize(static_cast<size_t>(bandLast - bandFirst + 1) * bufferRowSize);
+    sum.resize(bufferRowSize);
+
+    // Horizontal pass: every source row of the band once, to the new width
+    for (int y = bandFirst; y <= bandLast; y++) {
+        resample_row<pixelFormatOfRows>(input + static_cast<size_t>(y - firstSourceRow) * rowStride,
+            &rowBuffer[static_cast<size_t>(y - bandFirst) * bufferRowSize], horizontalTaps, newWidth);
+    }
+
+    // Vertical pass: whole rows are accumulated tap by tap, the inner loop runs along the row
+    for (int i = firstRow; i < endRow; i++) {
+        const short* weights = &verticalTaps.weights[static_cast<size_t>(i) * verticalTaps.taps];
+        const unsigned char* bufferRow = &rowBuffer[static_cast<size_t>(verticalTaps.first[i] - bandFirst) * bufferRowSize];
+
+        std::fill(sum.begin(), sum.end(), 0);
+        for (int t = 0; t < verticalTaps.taps; t++) {
+            const int weight = weights[t];
+            if (weight != 0) {
+                for (size_t k = 0; k < bufferRowSize; k++) {
+                    sum[k] += weight * bufferRow[k];
+                }
+            }
+            bufferRow += bufferRowSize;
+        }
+
+        unsigned char* outputRow = output + static_cast<size_t>(i - firstRow) * newRowStride;
+        if (!traits::packed) {
+            for (size_t k = 0; k < newRowSize; k++) {
+                outputRow[k] = static_cast<unsigned char>(clamp_channel(sum[k], 255));
+            }
+            continue;
+        }
+
+        const int* pixelSum = sum.data();
+        for (int j = 0; j < newWidth; j++) {
+            unsigned int channel[traits::channels];
+            for (size_t chn = 0; chn < traits::channels; chn++) {
+                channel[chn] = clamp_channel(pixelSum[chn], traits::max_value(chn));
+            }
+            traits::store(channel, outputRow);
+            pixelSum += traits::channels;
+            outputRow += traits::bytes;
+        }
+    }
+}
+
+template <pixelFormat pixelFormatOfRows>
+void Resampler::ResizeRowsLinear(const char* originalPixels, int firstSourceRow, size_t rowStride, char* resizedPixels,
+    size_t newRowStride, int firstRow, int endRow) const
+{
+    typedef linear_traits<pixelFormatOfRows> traits;
+
+    const t_lineartables& tables = linear_tables();
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(originalPixels);
+    unsigned char* output = reinterpret_cast<unsigned char*>(resizedPixels);
+    const size_t bufferRowSize = static_cast<size_t>(newWidth) * traits::channels;
+
+    int bandFirst, bandLast;
+    SourceRows(firstRow, endRow, bandFirst, bandLast);
+
+    // Buffers of the thread running the band, kept for its next band
+    static thread_local std::vector<uint16_t> rowBuffer;
+    static thread_local std::vector<int64_t> sum;
+    rowBuffer.resize(static_cast<size_t>(bandLast - bandFirst + 1) * bufferRowSize);
+    sum.resize(bufferRowSize);
+
+    // Horizontal pass: every source row of the band once, to the new width
+    for (int y = bandFirst; y <= bandLast; y++) {
+        resample_row_linear<pixelFormatOfRows>(tables, input + static_cast<size_t>(y - firstSourceRow) * rowStride,
+            &rowBuffer[static_cast<size_t>(y - bandFirst) * bufferRowSize], horizontalTaps, newWidth);
+    }
+
+    // Vertical pass: whole rows are accumulated tap by tap, then unpremultiplied and encoded pixel by pixel
+    for (int i = firstRow; i < endRow; i++) {
+        const short* weights = &verticalTaps.weights[static_cast<size_t>(i) * verticalTaps.taps];
+        const uint16_t* bufferRow = &rowBuffer[static_cast<size_t>(verticalTaps.first[i] - bandFirst) * bufferRowSize];
+
+        std::fill(sum.begin(), sum.end(), 0);
+        for (int t = 0; t < verticalTaps.taps; t++) {
+            const int64_t weight = weights[t];
+            if (weight != 0) {
+                for (size_t k = 0; k < bufferRowSize; k++) {
+                    sum[k] += weight * bufferRow[k];
+                }
+            }
+            bufferRow += bufferRowSize;
+        }
+
+        unsigned char* outputRow = output + static_cast<size_t>(i - firstRow) * newRowStride;
+        const int64_t* pixelSum = sum.data();
+        for (int j = 0; j < newWidth; j++) {
+            unsigned int channel[traits::channels];
+            for (size_t chn = 0; chn < traits::channels; chn++) {
+                channel[chn] = clamp_linear(pixelSum[chn]);
+            }
+            traits::store(tables, channel, outputRow);
+            pixelSum += traits::channels;
+            outputRow += traits::bytes;
+        }
+    }
+}
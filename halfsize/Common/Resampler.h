@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Utilities.h"
+
+
+#define RESAMPLE_WEIGHT_BITS    14      // fixed-point filter weights, 1.0 = 1 << RESAMPLE_WEIGHT_BITS
+
+
+/**
+Filter taps of one axis
+Output index i reads the source indices first[i] .. first[i] + taps - 1, weighted by
+weights[i * taps] .. weights[i * taps + taps - 1]. Every output index has the same number of taps,
+unused ones have a weight of 0, and all the indices lie inside the source image.
+*/
+typedef struct
+{
+    int                 taps;
+    std::vector<int>    first;
+    std::vector<short>  weights;
+} t_resampletaps;
+
+
+/**
+Separable polyphase resampler for any pair of image sizes
+The taps and fixed-point weights of every output column and row are computed once in the constructor.
+Resize() filters the source rows of a band horizontally into a row buffer, then filters the buffered
+rows vertically into the output, so each source row is read once per band. The row buffers belong to
+the threads running the bands and are kept between calls.
+*/
+class Resampler
+{
+public:
+    /**
+    * @param interpolationMethod - LANCZOS3_FILTER, BICUBIC_FILTER or AREA_FILTER
+    * @param width               - pixel width of original image
+    * @param height              - pixel height of original image
+    * @param newWidth            - pixel width of resized image
+    * @param newHeight           - pixel height of resized image
+    * @param format              - pixel format, the passes for it are picked here and not per band
+    * @param linearLight         - filter in premultiplied linear light, see LinearLight.h, the format must support it
+    */
+    Resampler(resizeMethod interpolationMethod, int width, int height, int newWidth, int newHeight, pixelFormat format,
+        bool linearLight);
+
+    /**
+    * Computes the taps for another filter or other sizes, reusing the memory of the previous ones
+    */
+    void Configure(resizeMethod interpolationMethod, int width, int height, int newWidth, int newHeight, pixelFormat format,
+        bool linearLight);
+
+    /**
+    * True if the taps were computed for this filter and these sizes
+    */
+    bool Matches(resizeMethod interpolationMethod, int width, int height, int newWidth, int newHeight, pixelFormat format,
+        bool linearLight) const;
+
+    /**
+    * Range of original image rows read to compute the output rows [firstRow, endRow)
+    */
+    void SourceRows(int firstRow, int endRow, int& firstSourceRow, int& lastSourceRow) const;
+
+    /**
+    * Resizes the output rows [firstRow, endRow), safe to call from several threads at once
+    *
+    * @param originalPixels - original image rows from firstSourceRow on
+    * @param firstSourceRow - first row held in originalPixels
+    * @param rowStride      - bytes from one original row to the next
+    * @param resizedPixels  - output row firstRow onwards
+    * @param newRowStride   - bytes from one output row to the next
+    * @param firstRow       - first output row
+    * @param endRow         - one past the last output row
+    */
+    void Resize(const char* originalPixels, int firstSourceRow, size_t rowStride, char* resizedPixels, size_t newRowStride,
+        int firstRow, int endRow) const;
+
+    /**
+    * True for the methods run by the Resampler
+    */
+    static bool IsSeparable(resizeMethod interpolationMethod);
+
+private:
+    resizeMethod    interpolationMethod;
+    int             width;
+    int             height;
+    int             newWidth;
+    int             newHeight;
+    pixelFormat     format;
+    bool            linearLight;
+
+    t_resampletaps  horizontalTaps;
+    t_resampletaps  verticalTaps;
+
+    // ResizeRows or ResizeRowsLinear instance of the pixel format
+    typedef void (Resampler::*t_resizerows)(const char*, int, size_t, char*, size_t, int, int) const;
+    t_resizerows    resizeRows;
+
+    template <pixelFormat pixelFormatOfRows>
+    void ResizeRows(const char* originalPixels, int firstSourceRow, size_t rowStride, char* resizedPixels, size_t newRowStride,
+        int firstRow, int endRow) const;
+
+    // same passes on 16 bit premultiplied linear light channels
+    template <pixelFormat pixelFormatOfRows>
+    void ResizeRowsLinear(const char* originalPixels, int firstSourceRow, size_t rowStride, char* resizedPixels, size_t newRowStride,
+        int firstRow, int endRow) const;
+};
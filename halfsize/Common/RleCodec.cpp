@@ -0,0 +1,188 @@
+#include "RleCodec.h"
+
+#include <cstring>
+
+
+#define RLE_STREAM_CHUNK    65536   // bytes read from a stream at once, larger than the biggest packet
+
+
+// Fills pattern with the pixel repeated RLE_PATTERN_SIZE / bitDepth times
+static void make_pattern(const unsigned char* pixel, size_t bitDepth, unsigned char* pattern)
+{
+    for (size_t offset = 0; offset < RLE_PATTERN_SIZE; offset += bitDepth) {
+        memcpy(pattern + offset, pixel, bitDepth);
+    }
+}
+
+// Writes pixelCount copies of the pixel held in pattern, RLE_PATTERN_SIZE bytes per store
+static void fill_pixels(unsigned char* output, const unsigned char* pattern, size_t pixelCount, size_t bitDepth)
+{
+    size_t bytes = pixelCount * bitDepth;
+    while (bytes >= RLE_PATTERN_SIZE) {
+        memcpy(output, pattern, RLE_PATTERN_SIZE);
+        output += RLE_PATTERN_SIZE;
+        bytes -= RLE_PATTERN_SIZE;
+    }
+    memcpy(output, pattern, bytes);
+}
+
+// ======================================================
+// Decoder
+
+RleDecoder::RleDecoder(size_t bitDepth)
+    : bitDepth(bitDepth), inputBegin(nullptr), cursor(nullptr), inputEnd(nullptr), stream(nullptr), streamBytes(0),
+      packetPixels(0), packetRepeat(false)
+{
+}
+
+void RleDecoder::SetInput(const char* data, size_t size)
+{
+    inputBegin = reinterpret_cast<const unsigned char*>(data);
+    cursor = inputBegin;
+    inputEnd = cursor + size;
+    stream = nullptr;
+    packetPixels = 0;
+}
+
+void RleDecoder::SetInput(std::istream* inputStream)
+{
+    streamBuffer.resize(RLE_STREAM_CHUNK);
+    inputBegin = nullptr;
+    cursor = streamBuffer.data();
+    inputEnd = cursor;
+    stream = inputStream;
+    streamBytes = 0;
+    packetPixels = 0;
+}
+
+bool RleDecoder::Ensure(size_t bytes)
+{
+    const size_t available = static_cast<size_t>(inputEnd - cursor);
+    if (available >= bytes)
+        return true;
+    if (stream == nullptr)
+        return false;
+
+    // move the unread tail to the front and top the buffer up
+    memmove(streamBuffer.data(), cursor, available);
+    stream->read(reinterpret_cast<char*>(streamBuffer.data()) + available,
+        static_cast<std::streamsize>(streamBuffer.size() - available));
+
+    cursor = streamBuffer.data();
+    inputEnd = cursor + available + static_cast<size_t>(stream->gcount());
+    streamBytes += static_cast<size_t>(stream->gcount());
+    return static_cast<size_t>(inputEnd - cursor) >= bytes;
+}
+
+void RleDecoder::SetBitDepth(size_t newBitDepth)
+{
+    bitDepth = newBitDepth;
+    packetPixels = 0;
+}
+
+size_t RleDecoder::GetBytesRead() const
+{
+    if (stream != nullptr)
+        return streamBytes;
+    return static_cast<size_t>(cursor - inputBegin);
+}
+
+bool RleDecoder::Decode(char* output, size_t pixelCount)
+{
+    unsigned char* outputPixel = reinterpret_cast<unsigned char*>(output);
+
+    while (pixelCount > 0) {
+        if (packetPixels == 0) {
+            // packet header: bit 7 = run-length packet, bits 6-0 = pixel count - 1
+            if (!Ensure(1))
+                return false;
+            const unsigned char packetHeader = *cursor++;
+            packetRepeat = (packetHeader & 0x80) != 0;
+            packetPixels = (packetHeader & 0x7F) + 1;
+
+            if (packetRepeat) {
+                if (!Ensure(bitDepth))
+                    return false;
+                make_pattern(cursor, bitDepth, repeatPattern);
+                cursor += bitDepth;
+            }
+        }
+
+        const size_t pixels = (packetPixels < pixelCount) ? packetPixels : pixelCount;
+        const size_t bytes = pixels * bitDepth;
+
+        if (packetRepeat) {
+            fill_pixels(outputPixel, repeatPattern, pixels, bitDepth);
+        }
+        else {
+            if (!Ensure(bytes))
+                return false;
+            memcpy(outputPixel, cursor, bytes);
+            cursor += bytes;
+        }
+
+        outputPixel += bytes;
+        packetPixels -= pixels;
+        pixelCount -= pixels;
+    }
+    return true;
+}
+
+// ======================================================
+// Encoder
+
+// Number of pixels equal to row[0], up to maxPixels, compared RLE_PATTERN_SIZE bytes at a time
+static int run_length(const unsigned char* row, int maxPixels, size_t bitDepth)
+{
+    unsigned char pattern[RLE_PATTERN_SIZE];
+    make_pattern(row, bitDepth, pattern);
+
+    const int blockPixels = static_cast<int>(RLE_PATTERN_SIZE / bitDepth);
+    int length = 0;
+    while (length + blockPixels <= maxPixels &&
+           memcmp(row + static_cast<size_t>(length) * bitDepth, pattern, RLE_PATTERN_SIZE) == 0) {
+        length += blockPixels;
+    }
+    while (length < maxPixels && memcmp(row + static_cast<size_t>(length) * bitDepth, pattern, bitDepth) == 0) {
+        length++;
+    }
+    return length;
+}
+
+void rle_encode_row(const char* row, int width, size_t bitDepth, std::vector<char>& output)
+{
+    const unsigned char* pixels = reinterpret_cast<const unsigned char*>(row);
+    int x = 0;
+
+    while (x < width) {
+        const int maxPixels = (width - x < RLE_MAX_PACKET) ? width - x : RLE_MAX_PACKET;
+        const unsigned char* pixel = pixels + static_cast<size_t>(x) * bitDepth;
+        const int run = run_length(pixel, maxPixels, bitDepth);
+
+        if (run >= 2) {
+            output.push_back(static_cast<char>(0x80 | (run - 1)));
+            output.insert(output.end(), row + static_cast<size_t>(x) * bitDepth, row + static_cast<size_t>(x + 1) * bitDepth);
+            x += run;
+            continue;
+        }
+
+        // raw packet up to the next pair of equal pixels
+        int raw = 1;
+        while (raw < maxPixels) {
+            const unsigned char* next = pixel + static_cast<size_t>(raw) * bitDepth;
+            if (raw + 1 < maxPixels && memcmp(next, next + bitDepth, bitDepth) == 0)
+                break;
+            raw++;
+        }
+
+        output.push_back(static_cast<char>(raw - 1));
+        output.insert(output.end(), row + static_cast<size_t>(x) * bitDepth, row + static_cast<size_t>(x + raw) * bitDepth);
+        x += raw;
+    }
+}
+
+size_t rle_max_row_size(int width, size_t bitDepth)
+{
+    const size_t packets = (static_cast<size_t>(width) + RLE_MAX_PACKET - 1) / RLE_MAX_PACKET;
+    return static_cast<size_t>(width) * bitDepth + packets;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+
+#define RLE_MAX_PACKET      128     // pixels per run-length or raw packet
+#define RLE_PATTERN_SIZE    48      // bytes of a repeated pixel pattern, a multiple of 1, 2, 3 and 4 byte pixels
+
+
+/**
+TGA run-length decoder (image types 10 and 11)
+Pixels are decoded in any number of calls, a packet may span two calls and several scanlines.
+The compressed data is taken from memory (e.g. a mapped file) or read in chunks from a stream.
+*/
+class RleDecoder
+{
+public:
+    explicit RleDecoder(size_t bitDepth);
+
+    /**
+    * Decodes from a buffer holding the compressed pixel data
+    *
+    * @param data - first byte of the compressed pixel data
+    * @param size - bytes available from data
+    */
+    void SetInput(const char* data, size_t size);
+
+    /**
+    * Decodes from a stream positioned at the compressed pixel data, read in chunks
+    *
+    * @param stream - stream to read from, must outlive the decoding
+    */
+    void SetInput(std::istream* stream);
+
+    /**
+    * Decodes pixels of bitDepth bytes from the next SetInput on, the decoder and its buffer can be reused
+    */
+    void SetBitDepth(size_t bitDepth);
+
+    /**
+    * Decodes the next pixelCount pixels
+    *
+    * @param output     - destination of pixelCount * bitDepth bytes
+    * @param pixelCount - number of pixels to decode
+    * @return false if the compressed data ends early
+    */
+    bool Decode(char* output, size_t pixelCount);
+
+    /**
+    * Bytes taken from the input so far, whole chunks when reading from a stream
+    */
+    size_t GetBytesRead() const;
+
+private:
+    size_t                      bitDepth;
+
+    const unsigned char*        inputBegin;
+    const unsigned char*        cursor;
+    const unsigned char*        inputEnd;
+    std::istream*               stream;
+    std::vector<unsigned char>  streamBuffer;
+    size_t                      streamBytes;
+
+    // packet being decoded
+    size_t                      packetPixels;
+    bool                        packetRepeat;
+    unsigned char               repeatPattern[RLE_PATTERN_SIZE];
+
+    bool Ensure(size_t bytes);
+};
+
+
+/**
+* Run-length encodes one scanline, packets never cross scanlines
+*
+* @param row      - pixels of the scanline
+* @param width    - number of pixels
+* @param bitDepth - number of bytes per pixel
+* @param output   - encoded bytes are appended to it
+*/
+void rle_encode_row(const char* row, int width, size_t bitDepth, std::vector<char>& output);
+
+/**
+* Worst case size of an encoded scanline
+*/
+size_t rle_max_row_size(int width, size_t bitDepth);
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+
+/**
+Per-image instrumentation of TGAProcessing
+Times are wall clock seconds summed over all calls of the stage, e.g. every band of a streamed image.
+*/
+typedef struct
+{
+    double  headerReadSeconds;      // reading and checking the header
+    double  payloadReadSeconds;     // reading or decoding the pixel data, 0 when it is memory-mapped
+    double  deinterleaveSeconds;    // planar path only, the fused kernels read interleaved pixels
+    double  interpolationSeconds;   // resize kernels and mip levels
+    double  interleaveSeconds;      // planar path only, the fused kernels write interleaved pixels
+    double  writeSeconds;           // header, encoding and writing of the output, or linking the cached one
+    double  hashSeconds;            // output cache key of the original image
+
+    size_t  bytesRead;              // bytes read from the input file
+    size_t  bytesWritten;           // bytes written to the output file(s)
+    size_t  allocations;            // heap buffers of t_tgadata allocated or grown
+    size_t  peakBufferBytes;        // largest total held by the t_tgadata buffers, mappings not included
+    size_t  cacheHits;              // 1 when the output came from the output cache, nothing was resized
+} t_tgastats;
+
+
+/**
+Adds the time between construction and Stop() or destruction to a stats field
+Does nothing when constructed with nullptr, i.e. when the stats are off.
+*/
+class StageTimer
+{
+public:
+    explicit StageTimer(double* seconds)
+        : seconds(seconds)
+    {
+        if (seconds != nullptr) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~StageTimer()
+    {
+        Stop();
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    void Stop()
+    {
+        if (seconds != nullptr) {
+            *seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            seconds = nullptr;
+        }
+    }
+
+private:
+    double* seconds;
+    std::chrono::steady_clock::time_point start;
+};
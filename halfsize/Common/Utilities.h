@@ -1,10 +1,17 @@
 #pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
 #include <string>
 #include <vector>
 
 #define SCALING_FACTOR      2
 #define IMAGEBIT_SIZE       8
 
+#define FIXED_POINT_BITS    16      // 16.16 fixed-point source positions
+#define BILINEAR_WEIGHT_BITS 11     // fraction bits of the bilinear weights, 1.0 = 2048
+
 #define ORIGINAL_IMAGE_NAME 1
 #define RESIZED_IMAGE_NAME  2
 
@@ -14,17 +21,31 @@ enum pixelBitDepth {
     PIXELDEPTH_32BIT = 4
 };
 
+enum pixelFormat {
+    PIXELFORMAT_GREY8  = 0,     // 8 bit greyscale
+    PIXELFORMAT_RGB555 = 1,     // 15/16 bit, little-endian A1 R5 G5 B5
+    PIXELFORMAT_BGR24  = 2,
+    PIXELFORMAT_BGRA32 = 3
+};
+
 enum fileStatus {
     FILE_ERR_OPEN = -1,
     FILE_OK = 0,
     FILE_ERR_BAD_FORMAT = 1,
     FILE_ERR_UNSUPPORTED,
+    FILE_ERR_BAD_REGION,        // region empty or not inside the image
+    FILE_ERR_BAD_BUFFER,        // pixel buffer missing, empty or with rows longer than its row stride
+    FILE_ERR_BAD_NAME,          // file name the server protocol cannot carry, it holds a tab or a line break
 };
 
 enum resizeMethod
 {
     NEAREST_NEIGHBOR = 0,
-    BILINEAR_INTERPOL = 1
+    BILINEAR_INTERPOL = 1,
+    BOX_FILTER_2X = 2,          // exact 2x2 average, only for a scale factor of 2 (others fall back to bilinear)
+    LANCZOS3_FILTER = 3,        // separable, Resampler
+    BICUBIC_FILTER = 4,         // separable, Resampler
+    AREA_FILTER = 5             // separable, Resampler: average of the source pixels weighted by their covered part
 };
 
 enum channelOrder {
@@ -33,107 +54,248 @@ enum channelOrder {
 };
 
 
+/**
+Layout of the pixels of one pixelFormat
+The kernels are templates over the format: a pixel is loaded into channels of at most 8 bits, each
+channel is filtered on its own and the result is stored back. For the byte formats a channel is a byte.
+*/
+template <pixelFormat format>
+struct pixel_traits;
+
+template <size_t pixelBytes>
+struct byte_pixel_traits
+{
+    static const size_t bytes = pixelBytes;         // bytes per pixel in the image
+    static const size_t channels = pixelBytes;      // channels once loaded
+    static const bool packed = false;               // channels share bytes
+
+    static unsigned int max_value(size_t) { return 255; }
+
+    static void load(const unsigned char* pixel, unsigned int* channel)
+    {
+        for (size_t chn = 0; chn < channels; chn++) {
+            channel[chn] = pixel[chn];
+        }
+    }
+
+    static void store(const unsigned int* channel, unsigned char* pixel)
+    {
+        for (size_t chn = 0; chn < channels; chn++) {
+            pixel[chn] = static_cast<unsigned char>(channel[chn]);
+        }
+    }
+};
+
+template <> struct pixel_traits<PIXELFORMAT_GREY8> : byte_pixel_traits<1> {};
+template <> struct pixel_traits<PIXELFORMAT_BGR24> : byte_pixel_traits<3> {};
+template <> struct pixel_traits<PIXELFORMAT_BGRA32> : byte_pixel_traits<4> {};
+
+// channels B G R of 5 bits and the attribute (alpha) bit, which is filtered like the others and rounded to 0 or 1
+template <>
+struct pixel_traits<PIXELFORMAT_RGB555>
+{
+    static const size_t bytes = 2;
+    static const size_t channels = 4;
+    static const bool packed = true;
+
+    static unsigned int max_value(size_t chn) { return (chn == 3) ? 1u : 31u; }
+
+    static void load(const unsigned char* pixel, unsigned int* channel)
+    {
+        const unsigned int value = pixel[0] | (pixel[1] << 8);
+        channel[0] = value & 0x1F;
+        channel[1] = (value >> 5) & 0x1F;
+        channel[2] = (value >> 10) & 0x1F;
+        channel[3] = value >> 15;
+    }
+
+    static void store(const unsigned int* channel, unsigned char* pixel)
+    {
+        const unsigned int value = channel[0] | (channel[1] << 5) | (channel[2] << 10) | (channel[3] << 15);
+        pixel[0] = static_cast<unsigned char>(value & 0xFF);
+        pixel[1] = static_cast<unsigned char>(value >> 8);
+    }
+};
+
+/**
+* Number of bytes per pixel of a pixel format
+*/
+inline size_t pixel_format_bytes(pixelFormat format)
+{
+    switch (format) {
+    case PIXELFORMAT_GREY8:  return pixel_traits<PIXELFORMAT_GREY8>::bytes;
+    case PIXELFORMAT_RGB555: return pixel_traits<PIXELFORMAT_RGB555>::bytes;
+    case PIXELFORMAT_BGR24:  return pixel_traits<PIXELFORMAT_BGR24>::bytes;
+    default:                 return pixel_traits<PIXELFORMAT_BGRA32>::bytes;
+    }
+}
+
+/**
+std::vector allocator of over-aligned storage, e.g. std::vector<char, aligned_allocator<char, 4096>>
+The block comes from operator new like any other vector, padded so that the first element starts on an
+alignment boundary; the pointer to the whole block is kept just before it.
+*/
+template <typename T, size_t alignment>
+struct aligned_allocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind { typedef aligned_allocator<U, alignment> other; };
+
+    aligned_allocator() = default;
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, alignment>&) {}
+
+    T* allocate(size_t count)
+    {
+        char* block = static_cast<char*>(::operator new(count * sizeof(T) + alignment + sizeof(void*)));
+        const uintptr_t first = (reinterpret_cast<uintptr_t>(block) + sizeof(void*) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        reinterpret_cast<void**>(first)[-1] = block;
+        return reinterpret_cast<T*>(first);
+    }
+
+    void deallocate(T* pointer, size_t)
+    {
+        ::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+    }
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U, alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const aligned_allocator<U, alignment>&) const { return false; }
+};
+
+/**
+Caller-owned interleaved pixels in memory
+Rows follow each other rowStride bytes apart, which may be more than width * bytes per pixel, e.g. for a
+padded texture or a sub-rectangle of a larger image. The bytes between the end of a row and the next one
+are neither read nor written.
+*/
+typedef struct
+{
+    char*       pixels;         // first pixel of the first row
+    int         width;          // pixels per row
+    int         height;         // rows
+    size_t      rowStride;      // bytes from the first pixel of a row to the first pixel of the next one
+    pixelFormat format;
+} t_imagebuffer;
+
+/**
+Resize kernel of one pixel format, computes the output rows [firstRow, endRow)
+The format is a template argument of the kernel, it is picked once per image and not per pixel.
+Rows are rowStride and newRowStride bytes apart, width * bytes per pixel for packed images.
+*/
+typedef void (*t_resizekernel)(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow);
+
+
+/**
+* Channel buffers in the order of the channels of a pixel, a grey pixel only fills the first one
+*
+* @param colorOrder - template argument, order of the colour channels in a pixel
+* @param planes     - the four channel buffers, in pixel order
+*/
+template <channelOrder colorOrder>
+inline void channel_planes(std::vector<char>& blueChn, std::vector<char>& greenChn, std::vector<char>& redChn,
+    std::vector<char>& alphaChn, std::vector<char>* planes[4])
+{
+    planes[0] = (BGRA == colorOrder) ? &blueChn : &redChn;
+    planes[1] = &greenChn;
+    planes[2] = (BGRA == colorOrder) ? &redChn : &blueChn;
+    planes[3] = &alphaChn;
+}
+
 /**
 * Interleave RGBA channels from seperate channel buffers
+* The pixel format and the channel order are template arguments, the loop does not branch per pixel
 *
 * @param resizedImagePixelData pointer to an array to hold the new interpolated pixel data
 * @param width  - pixel width of original image
 * @param height - pixel height of original image
-* @param pixelDepth - defines the number of bits pers channel (32 bit or 24 bit)
 * @param blueChn        - initialized vector for to hold interpolated blue pixels
 * @param greenChn       - initialized vector for to hold interpolated green pixels
 * @param redChn         - initialized vector for to hold interpolated red pixels
 * @param alphaChn       - initialized vector for to hold interpolated alpha pixels
 * @param scalingFactor  - resizing scale factor ( > 1 shrik, < 1 enlarge)
-* @param colorOrder     - to fetch the correct order of color pixels
-* @return Inited GIF Handler or NULL for error
 */
-inline void interleave_rgba_channels(char* resizedImagePixelData, short& width, short& height, char& pixelDepth,
+template <pixelFormat format, channelOrder colorOrder>
+inline void interleave_rgba_channels(char* resizedImagePixelData, int width, int height,
     std::vector<char>& blueChn, std::vector<char>& greenChn, std::vector<char>& redChn,
-    std::vector<char>& alphaChn, float& scalingFactor, channelOrder colorOrder) 
+    std::vector<char>& alphaChn, float& scalingFactor)
 {
-    const size_t bitDepth = (pixelDepth / IMAGEBIT_SIZE);
-
-    const int newHeight = height / SCALING_FACTOR;
-    const int newWidth = width / SCALING_FACTOR;
-    const int newArea = newHeight * newWidth;
-
-    //resizedImagePixelData = new char[newArea * bitDepth];
-
-    if (BGRA == colorOrder) {
-        int sampleIdx = 0;
-        for (int bgrIdx = 0; bgrIdx < newArea; bgrIdx++)
-        {
-            // order needs to be BRG
-            resizedImagePixelData[sampleIdx] = blueChn[bgrIdx];
-            sampleIdx++;
-            resizedImagePixelData[sampleIdx] = greenChn[bgrIdx];
-            sampleIdx++;
-            resizedImagePixelData[sampleIdx] = redChn[bgrIdx];
-            sampleIdx++;
-
-            if (bitDepth == PIXELDEPTH_32BIT)
-            {
-                resizedImagePixelData[sampleIdx] = alphaChn[bgrIdx];
-                sampleIdx++;
-            }
+    typedef pixel_traits<format> traits;
+
+    const int newHeight = static_cast<int>(static_cast<float>(height) / scalingFactor);
+    const int newWidth = static_cast<int>(static_cast<float>(width) / scalingFactor);
+    const size_t newArea = static_cast<size_t>(newHeight) * static_cast<size_t>(newWidth);
+
+    std::vector<char>* planes[4];
+    channel_planes<colorOrder>(blueChn, greenChn, redChn, alphaChn, planes);
+    const char* planeData[4] = { planes[0]->data(), planes[1]->data(), planes[2]->data(), planes[3]->data() };
+
+    unsigned char* outputPixel = reinterpret_cast<unsigned char*>(resizedImagePixelData);
+    for (size_t sampleIdx = 0; sampleIdx < newArea; sampleIdx++)
+    {
+        unsigned int channel[traits::channels];
+        for (size_t chn = 0; chn < traits::channels; chn++) {
+            channel[chn] = static_cast<unsigned char>(planeData[chn][sampleIdx]);
         }
+        traits::store(channel, outputPixel);
+        outputPixel += traits::bytes;
     }
 }
 
 /**
 * Deinterleave RGBA channels from 1 x (width * height)  buffer
+* The pixel format and the channel order are template arguments, the loop does not branch per pixel.
+* Channels the format does not have are left empty.
 *
 * @param originalImagePixelData - pointer to an array that holds the original pixel data
 * @param width                  - pixel width of original image
 * @param height                 - pixel height of original image
-* @param pixelDepth             - defines the number of bits pers channel (32 bit or 24 bit)
 * @param blueChn                - initialized vector for to hold original blue pixels
 * @param greenChn               - initialized vector for to hold original green pixels
 * @param redChn                 - initialized vector for to hold original red pixels
 * @param alphaChn               - initialized vector for to hold original alpha pixels
-* @param colorOrder             - to fetch the correct order of color pixels
 */
-inline void deinterleave_rgba_channels(char* originalImagePixelData, short& width, short& height, char& pixelDepth,
-    std::vector<char>& blueChn, std::vector<char>& greenChn, std::vector<char>& redChn, std::vector<char>& alphaChn,
-    channelOrder colorOrder)
+template <pixelFormat format, channelOrder colorOrder>
+inline void deinterleave_rgba_channels(const char* originalImagePixelData, int width, int height,
+    std::vector<char>& blueChn, std::vector<char>& greenChn, std::vector<char>& redChn, std::vector<char>& alphaChn)
 {
-   // pixel area * BGR values
-   const size_t pixelArea = (const size_t)(width) * (const size_t)(height);
-   const size_t bitDepth = (pixelDepth / IMAGEBIT_SIZE);
-   const size_t pixelAreaBitSize = (pixelArea * bitDepth);
-
-
-   if (BGRA == colorOrder)
-   {
-       for (int sampleIdx = 0; sampleIdx < pixelAreaBitSize / bitDepth; sampleIdx++)
-       {
-           // BGR [0] [1] [2]
-           blueChn.push_back(*originalImagePixelData);
-           originalImagePixelData++;
-           greenChn.push_back(*originalImagePixelData);
-           originalImagePixelData++;
-           redChn.push_back(*originalImagePixelData);
-           originalImagePixelData++;
-
-           if (bitDepth == PIXELDEPTH_32BIT) {
-               alphaChn.push_back(*originalImagePixelData);
-               originalImagePixelData++;
-           }
-       }
-   }
+    typedef pixel_traits<format> traits;
+
+    const size_t pixelArea = (const size_t)(width) * (const size_t)(height);
+
+    // the channels are overwritten, their capacity is reused from one image to the next
+    std::vector<char>* planes[4];
+    channel_planes<colorOrder>(blueChn, greenChn, redChn, alphaChn, planes);
+    char* planeData[4];
+    for (size_t chn = 0; chn < 4; chn++) {
+        planes[chn]->resize((chn < traits::channels) ? pixelArea : 0);
+        planeData[chn] = planes[chn]->data();
+    }
 
+    const unsigned char* inputPixel = reinterpret_cast<const unsigned char*>(originalImagePixelData);
+    for (size_t sampleIdx = 0; sampleIdx < pixelArea; sampleIdx++)
+    {
+        unsigned int channel[traits::channels];
+        traits::load(inputPixel, channel);
+        for (size_t chn = 0; chn < traits::channels; chn++) {
+            planeData[chn][sampleIdx] = static_cast<char>(channel[chn]);
+        }
+        inputPixel += traits::bytes;
+    }
 }
 
 
 
 /**
-* Nearest Neighbor Interpolation 
+* Nearest Neighbor Interpolation of the channel buffers filled by deinterleave_rgba_channels
 *
 * @param scaleFactor     - pointer to an array that holds the original pixel data
 * @param width           - pixel width of original image
 * @param height          - pixel height of original image
-* @param pixelDepth      - defines the number of bits pers channel (32 bit or 24 bit)
 * @param blueChn         - initialized vector for to hold original blue pixels
 * @param greenChn        - initialized vector for to hold original green pixels
 * @param redChn          - initialized vector for to hold original red pixels
@@ -143,17 +305,19 @@ inline void deinterleave_rgba_channels(char* originalImagePixelData, short& widt
 * @param redChnResized   - initialized vector for to hold interpolated red pixels
 * @param alphaChnResized - initialized vector for to hold interpolated alpha pixels
 */
-inline void nn_interpolation(float scaleFactor, short& width, short& height, char& pixelDepth,
+template <pixelFormat format>
+inline void nn_interpolation(float scaleFactor, int width, int height,
     std::vector<char>& blueChn, std::vector<char>& greenChn, std::vector<char>& redChn, std::vector<char>& alphaChn,
     std::vector<char>& blueChnResized, std::vector<char>& greenChnResized, std::vector<char>& redChnResized, std::vector<char>& alphaChnResized) 
 {
-    const size_t bitDepth = (pixelDepth / IMAGEBIT_SIZE);
+    const size_t channelCount = pixel_traits<format>::channels;
     //const int newHeight = height / scaleFactor;
     const int newHeight = static_cast<const int>(static_cast<float>(height) / scaleFactor);
     //const int newWidth = width / scaleFactor;
     const int newWidth = static_cast<const int>(static_cast<float>(width) / scaleFactor);
-    const int newArea = newHeight * newWidth;
 
+    const char* channels[] = { blueChn.data(), greenChn.data(), redChn.data(), alphaChn.data() };
+    char* channelsResized[] = { blueChnResized.data(), greenChnResized.data(), redChnResized.data(), alphaChnResized.data() };
 
     float x_ratio = static_cast<float>(width )/ static_cast<float>(newWidth);
     float y_ratio = static_cast<float>(height) / static_cast<float>(newHeight);
@@ -162,15 +326,11 @@ inline void nn_interpolation(float scaleFactor, short& width, short& height, cha
         for (int j = 0; j < newWidth; j++) {
             float px = floorf(static_cast<float>(j) * x_ratio);
             float py = floorf(static_cast<float>(i) * y_ratio);
-            int output_index = i * newWidth + j;
-            int input_index = static_cast<int>((py * static_cast<float>(width)) + px);
+            const size_t output_index = static_cast<size_t>(i) * static_cast<size_t>(newWidth) + static_cast<size_t>(j);
+            const size_t input_index = static_cast<size_t>(py) * static_cast<size_t>(width) + static_cast<size_t>(px);
 
-            blueChnResized[output_index]  = blueChn[input_index];
-            greenChnResized[output_index] = greenChn[input_index];
-            redChnResized[output_index]   = redChn[input_index];
-
-            if (bitDepth == PIXELDEPTH_32BIT) {
-                alphaChnResized[output_index] = alphaChn[input_index];
+            for (size_t chn = 0; chn < channelCount; chn++) {
+                channelsResized[chn][output_index] = channels[chn][input_index];
             }
         }
     }
@@ -178,12 +338,51 @@ inline void nn_interpolation(float scaleFactor, short& width, short& height, cha
 
 
 /**
-* Bilinear Interpolation
+* Source pixels and weight of one output row or column for bilinear interpolation
+* Pixel centres are aligned, as in the Resampler: output pixel index samples the source at
+* (index + 0.5) * size / newSize - 0.5, clamped to the first and last pixel. Halving thus blends each pair of
+* source pixels equally instead of picking one of them. The position is exact in 16.16 fixed point, a
+* fixed-point step would drift along the row.
+*
+* @param index   - output row or column
+* @param size    - original size in pixels
+* @param newSize - resized size in pixels
+* @param sample  - first source pixel
+* @param next   - second source pixel
+* @param weight - weight of the second pixel, 0 .. (1 << BILINEAR_WEIGHT_BITS) - 1
+*/
+inline void bilinear_sample(int index, int size, int newSize, int& sample, int& next, int& weight)
+{
+    const int64_t center = (static_cast<int64_t>(2 * static_cast<int64_t>(index) + 1) * size << FIXED_POINT_BITS) /
+                           (2 * static_cast<int64_t>(newSize));
+    const int64_t last = static_cast<int64_t>(size - 1) << FIXED_POINT_BITS;
+    int64_t position = center - (static_cast<int64_t>(1) << (FIXED_POINT_BITS - 1));
+    position = (position < 0) ? 0 : (position > last) ? last : position;
+
+    sample = static_cast<int>(position >> FIXED_POINT_BITS);
+    next = (sample + 1 < size) ? sample + 1 : sample;
+    weight = static_cast<int>((position >> (FIXED_POINT_BITS - BILINEAR_WEIGHT_BITS)) & ((1 << BILINEAR_WEIGHT_BITS) - 1));
+}
+
+/**
+* Bilinear blend of four unsigned bytes with integer weights, rounded to nearest
+* Intermediate sums stay below 2^30, so four pixels fit 32 bit lanes
+*/
+inline unsigned int bilinear_blend(unsigned int a, unsigned int b, unsigned int c, unsigned int d, int x_weight, int y_weight)
+{
+    const unsigned int one = 1u << BILINEAR_WEIGHT_BITS;
+    const unsigned int top = a * (one - x_weight) + b * x_weight;
+    const unsigned int bottom = c * (one - x_weight) + d * x_weight;
+    return (top * (one - y_weight) + bottom * y_weight + (1u << (2 * BILINEAR_WEIGHT_BITS - 1))) >> (2 * BILINEAR_WEIGHT_BITS);
+}
+
+
+/**
+* Bilinear Interpolation of the channel buffers filled by deinterleave_rgba_channels
 *
 * @param scaleFactor     - pointer to an array that holds the original pixel data
 * @param width           - pixel width of original image
 * @param height          - pixel height of original image
-* @param pixelDepth      - defines the number of bits pers channel (32 bit or 24 bit)
 * @param blueChn         - initialized vector for to hold original blue pixels
 * @param greenChn        - initialized vector for to hold original green pixels
 * @param redChn          - initialized vector for to hold original red pixels
@@ -193,74 +392,204 @@ inline void nn_interpolation(float scaleFactor, short& width, short& height, cha
 * @param redChnResized   - initialized vector for to hold interpolated red pixels
 * @param alphaChnResized - initialized vector for to hold interpolated alpha pixels
 */
-inline void bilinear_interpolation(float scaleFactor, short& width, short& height, char& pixelDepth,
+template <pixelFormat format>
+inline void bilinear_interpolation(float scaleFactor, int width, int height,
     std::vector<char>& blueChn, std::vector<char>& greenChn, std::vector<char>& redChn, std::vector<char>& alphaChn,
     std::vector<char>& blueChnResized, std::vector<char>& greenChnResized, std::vector<char>& redChnResized, std::vector<char>& alphaChnResized) 
 {
-    const size_t bitDepth = (pixelDepth / IMAGEBIT_SIZE);
+    const size_t channelCount = pixel_traits<format>::channels;
     const int newHeight = static_cast<const int>(static_cast<float>(height) / scaleFactor);
     const int newWidth  = static_cast<const int>(static_cast<float>(width) / scaleFactor);
-    const int newArea   = newHeight * newWidth;
 
-    float x_ratio = static_cast<float>(width)  / static_cast<float>(newWidth);
-    float y_ratio = static_cast<float>(height) / static_cast<float>(newHeight);
+    const unsigned char* channels[] = {
+        reinterpret_cast<const unsigned char*>(blueChn.data()), reinterpret_cast<const unsigned char*>(greenChn.data()),
+        reinterpret_cast<const unsigned char*>(redChn.data()), reinterpret_cast<const unsigned char*>(alphaChn.data()) };
+    char* channelsResized[] = { blueChnResized.data(), greenChnResized.data(), redChnResized.data(), alphaChnResized.data() };
 
-    int offset = 0;
-    // border pixels for the new interpolated pixel
-    int a, b, c, d;
-    int pixel;
     for (int i = 0; i < newHeight; i++) {
+        int y, y_next, y_weight;
+        bilinear_sample(i, height, newHeight, y, y_next, y_weight);
+
+        for (int j = 0; j < newWidth; j++) {
+            int x, x_next, x_weight;
+            bilinear_sample(j, width, newWidth, x, x_next, x_weight);
+
+            // border pixels for the new interpolated pixel, clamped to the last row and column
+            const size_t row = static_cast<size_t>(y) * static_cast<size_t>(width);
+            const size_t nextRow = static_cast<size_t>(y_next) * static_cast<size_t>(width);
+            const size_t input_index_a = row + static_cast<size_t>(x);
+            const size_t input_index_b = row + static_cast<size_t>(x_next);
+            const size_t input_index_c = nextRow + static_cast<size_t>(x);
+            const size_t input_index_d = nextRow + static_cast<size_t>(x_next);
+            const size_t output_index = static_cast<size_t>(i) * static_cast<size_t>(newWidth) + static_cast<size_t>(j);
+
+            for (size_t chn = 0; chn < channelCount; chn++) {
+                const unsigned char* channel = channels[chn];
+                channelsResized[chn][output_index] = static_cast<char>(bilinear_blend(
+                    channel[input_index_a], channel[input_index_b], channel[input_index_c], channel[input_index_d],
+                    x_weight, y_weight));
+            }
+        }
+    }
+}
+
+
+/**
+* Nearest Neighbor Interpolation on interleaved pixel data
+*
+* Fused kernel: pixels are read straight from the interleaved buffer and written straight to the
+* resized buffer, without going through separate channel buffers. The pixel format is a template
+* argument, each pixel is a copy of pixel_traits<format>::bytes bytes.
+*
+* @param originalImagePixelData - pointer to the original pixel data, starting at row firstSourceRow
+* @param firstSourceRow         - original image row held at originalImagePixelData (0 for a whole image)
+* @param width                  - pixel width of original image
+* @param height                 - pixel height of original image
+* @param rowStride              - bytes from one original row to the next
+* @param resizedImagePixelData  - pointer to the resized pixel data of row firstRow
+* @param newWidth               - pixel width of resized image
+* @param newHeight              - pixel height of resized image
+* @param newRowStride           - bytes from one resized row to the next
+* @param firstRow               - first output row to compute
+* @param endRow                 - output row after the last one to compute
+*/
+template <pixelFormat format>
+inline void nn_interpolation_interleaved(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow)
+{
+    const size_t bitDepth = pixel_traits<format>::bytes;
+    const float x_ratio = static_cast<float>(width) / static_cast<float>(newWidth);
+    const float y_ratio = static_cast<float>(height) / static_cast<float>(newHeight);
+
+    for (int i = firstRow; i < endRow; i++) {
+        const int py = static_cast<int>(floorf(static_cast<float>(i) * y_ratio));
+        const char* inputRow = originalImagePixelData + static_cast<size_t>(py - firstSourceRow) * rowStride;
+        char* outputPixel = resizedImagePixelData + static_cast<size_t>(i - firstRow) * newRowStride;
+
         for (int j = 0; j < newWidth; j++) {
-            int x = static_cast<int>(floorf(static_cast<float>(j) * x_ratio));
-            int y = static_cast<int>(floorf(static_cast<float>(i) * y_ratio));
-            float x_diff = (static_cast<float>(j) * x_ratio) - static_cast<float>(x);
-            float y_diff = (static_cast<float>(i) * y_ratio) - static_cast<float>(y);
-            int output_index = i * static_cast<int>(newWidth) + j;
-
-            // calculating next idxs
-            int input_index_a = y * static_cast<int>(width) + x;
-            int input_index_b = input_index_a + 1;
-            int input_index_c = input_index_a + static_cast<int>(width);
-            int input_index_d = input_index_a + static_cast<int>(width) + 1;
-
-            // blue channel
-            a = blueChn[input_index_a];
-            b = blueChn[input_index_b];
-            c = blueChn[input_index_c];
-            d = blueChn[input_index_d];
-
-            pixel = static_cast<int>(a * (1 - x_diff) * 1 - y_diff + b * (x_diff) * (1 - y_diff) + c * (y_diff) * (1 - x_diff) + d * (x_diff * y_diff));
-            blueChnResized[output_index] = blueChn[input_index_a];
-
-            // green channel
-            a = greenChn[input_index_a];
-            b = greenChn[input_index_b];
-            c = greenChn[input_index_c];
-            d = greenChn[input_index_d];
-
-            pixel = static_cast<int>(a * (1 - x_diff) * 1 - y_diff + b * (x_diff) * (1 - y_diff) + c * (y_diff) * (1 - x_diff) + d * (x_diff * y_diff));
-            greenChnResized[output_index] = greenChn[input_index_a];
-
-            // red channel
-            a = redChn[input_index_a];
-            b = redChn[input_index_b];
-            c = redChn[input_index_c];
-            d = redChn[input_index_d];
-
-            pixel = static_cast<int>(a * (1 - x_diff) * 1 - y_diff + b * (x_diff) * (1 - y_diff) + c * (y_diff) * (1 - x_diff) + d * (x_diff * y_diff));
-            redChnResized[output_index] = redChn[input_index_a];
-
-            if (bitDepth == PIXELDEPTH_32BIT) {
-                // red channel
-                a = alphaChn[input_index_a];
-                b = alphaChn[input_index_b];
-                c = alphaChn[input_index_c];
-                d = alphaChn[input_index_d];
-
-                pixel = static_cast<int>(a * (1 - x_diff) * 1 - y_diff + b * (x_diff) * (1 - y_diff) + c * (y_diff) * (1 - x_diff) + d * (x_diff * y_diff));
-                alphaChnResized[output_index] = alphaChn[input_index_a];
+            const int px = static_cast<int>(floorf(static_cast<float>(j) * x_ratio));
+            const char* inputPixel = inputRow + static_cast<size_t>(px) * bitDepth;
+
+            for (size_t byte = 0; byte < bitDepth; byte++) {
+                outputPixel[byte] = inputPixel[byte];
             }
+            outputPixel += bitDepth;
         }
     }
+}
+
 
-}
\ No newline at end of file
+/**
+* Bilinear blend of one row of interleaved pixels, the channel loop is unrolled for each pixel format
+*/
+template <pixelFormat format>
+inline void bilinear_blend_row(const unsigned char* inputRowA, const unsigned char* inputRowC, unsigned char* outputPixel,
+    const size_t* columnOffsets, const size_t* nextOffsets, const int* columnWeights, int newWidth, int y_weight)
+{
+    typedef pixel_traits<format> traits;
+
+    for (int j = 0; j < newWidth; j++) {
+        // border pixels for the new interpolated pixel
+        unsigned int a[traits::channels], b[traits::channels], c[traits::channels], d[traits::channels];
+        traits::load(inputRowA + columnOffsets[j], a);
+        traits::load(inputRowA + nextOffsets[j], b);
+        traits::load(inputRowC + columnOffsets[j], c);
+        traits::load(inputRowC + nextOffsets[j], d);
+
+        unsigned int blended[traits::channels];
+        for (size_t chn = 0; chn < traits::channels; chn++) {
+            blended[chn] = bilinear_blend(a[chn], b[chn], c[chn], d[chn], columnWeights[j], y_weight);
+        }
+        traits::store(blended, outputPixel);
+        outputPixel += traits::bytes;
+    }
+}
+
+/**
+* Bilinear Interpolation on interleaved pixel data
+*
+* Fused kernel: each channel of the four neighbouring pixels is read straight from the
+* interleaved buffer. Neighbours past the right and bottom edges are clamped to
+* the last column/row. Positions are 16.16 fixed point and the source columns and weights
+* are computed once per call, not per pixel. The pixel format is a template argument.
+*
+* @param originalImagePixelData - pointer to the original pixel data, starting at row firstSourceRow
+* @param firstSourceRow         - original image row held at originalImagePixelData (0 for a whole image)
+* @param width                  - pixel width of original image
+* @param height                 - pixel height of original image
+* @param rowStride              - bytes from one original row to the next
+* @param resizedImagePixelData  - pointer to the resized pixel data of row firstRow
+* @param newWidth               - pixel width of resized image
+* @param newHeight              - pixel height of resized image
+* @param newRowStride           - bytes from one resized row to the next
+* @param firstRow               - first output row to compute
+* @param endRow                 - output row after the last one to compute
+*/
+template <pixelFormat format>
+inline void bilinear_interpolation_interleaved(const char* originalImagePixelData, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedImagePixelData, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow)
+{
+    const size_t bitDepth = pixel_traits<format>::bytes;
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(originalImagePixelData);
+    unsigned char* outputPixel = reinterpret_cast<unsigned char*>(resizedImagePixelData);
+
+    // byte offsets of the two source pixels and weight of every output column
+    // one table per thread, kept from call to call so bands do not allocate
+    static thread_local std::vector<size_t> offsetTable;
+    static thread_local std::vector<int> weightTable;
+    offsetTable.resize(static_cast<size_t>(newWidth) * 2);
+    weightTable.resize(static_cast<size_t>(newWidth));
+    size_t* columnOffsets = offsetTable.data();
+    size_t* nextOffsets = columnOffsets + newWidth;
+    int* columnWeights = weightTable.data();
+
+    for (int j = 0; j < newWidth; j++) {
+        int x, x_next;
+        bilinear_sample(j, width, newWidth, x, x_next, columnWeights[j]);
+        columnOffsets[j] = static_cast<size_t>(x) * bitDepth;
+        nextOffsets[j] = static_cast<size_t>(x_next) * bitDepth;
+    }
+
+    for (int i = firstRow; i < endRow; i++) {
+        int y, y_next, y_weight;
+        bilinear_sample(i, height, newHeight, y, y_next, y_weight);
+
+        const unsigned char* inputRowA = input + static_cast<size_t>(y - firstSourceRow) * rowStride;
+        const unsigned char* inputRowC = input + static_cast<size_t>(y_next - firstSourceRow) * rowStride;
+
+        bilinear_blend_row<format>(inputRowA, inputRowC, outputPixel, columnOffsets, nextOffsets, columnWeights, newWidth, y_weight);
+        outputPixel += newRowStride;
+    }
+}
+
+
+/**
+* Range of original image rows read to compute one output row
+* Matches the row selection of the kernels above and of box_filter_half
+*
+* @param interpolationMethod - resizing method
+* @param row                 - output row
+* @param height              - pixel height of original image
+* @param newHeight           - pixel height of resized image
+* @param firstSourceRow      - first original row read
+* @param lastSourceRow       - last original row read
+*/
+inline void source_rows_for_output_row(resizeMethod interpolationMethod, int row, int height, int newHeight,
+    int& firstSourceRow, int& lastSourceRow)
+{
+    if (BOX_FILTER_2X == interpolationMethod) {
+        firstSourceRow = row * 2;
+        lastSourceRow = row * 2 + 1;
+        return;
+    }
+
+    if (BILINEAR_INTERPOL == interpolationMethod) {
+        int weight;
+        bilinear_sample(row, height, newHeight, firstSourceRow, lastSourceRow, weight);
+        return;
+    }
+
+    const float y_ratio = static_cast<float>(height) / static_cast<float>(newHeight);
+    firstSourceRow = static_cast<int>(floorf(static_cast<float>(row) * y_ratio));
+    lastSourceRow = firstSourceRow;
+}
@@ -0,0 +1,419 @@
+#include "ResizeServer.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "../TGAProcessing/TGAProcessing.h"
+
+#define SERVER_FIELD_SEPARATOR  '\t'
+#define SERVER_READ_SIZE        512     // bytes read from a connection at a time
+
+
+// ======================================================
+// Protocol, one line per request and per reply
+
+// Fields are not escaped, a path holding a separator would be read back as other fields
+static bool is_protocol_safe(const std::string& field)
+{
+    return field.find(SERVER_FIELD_SEPARATOR) == std::string::npos && field.find('\n') == std::string::npos;
+}
+
+static std::vector<std::string> split_fields(const std::string& line)
+{
+    std::vector<std::string> fields;
+    size_t first = 0;
+    for (;;) {
+        const size_t separator = line.find(SERVER_FIELD_SEPARATOR, first);
+        fields.push_back(line.substr(first, separator - first));
+        if (separator == std::string::npos)
+            return fields;
+        first = separator + 1;
+    }
+}
+
+static std::string format_request(const t_resizerequest& request)
+{
+    // 9 significant digits give back the same float
+    char scale[32];
+    snprintf(scale, sizeof(scale), "%.9g", request.scaleFactor);
+
+    return std::string("resize") + SERVER_FIELD_SEPARATOR + request.inputFileName + SERVER_FIELD_SEPARATOR +
+           request.outputFileName + SERVER_FIELD_SEPARATOR + scale + SERVER_FIELD_SEPARATOR +
+           std::to_string(static_cast<int>(request.interpolationMethod)) + SERVER_FIELD_SEPARATOR +
+           (request.rleOutput ? "1" : "0") + SERVER_FIELD_SEPARATOR + (request.linearLight ? "1" : "0") + "\n";
+}
+
+static bool parse_request(const std::string& line, t_resizerequest& request)
+{
+    const std::vector<std::string> fields = split_fields(line);
+    if (fields.size() != 7 || fields[0] != "resize" || fields[1].empty() || fields[2].empty())
+        return false;
+
+    request.inputFileName = fields[1];
+    request.outputFileName = fields[2];
+    request.scaleFactor = std::strtof(fields[3].c_str(), nullptr);
+    const int method = std::atoi(fields[4].c_str());
+    request.interpolationMethod = static_cast<resizeMethod>(method);
+    request.rleOutput = (fields[5] == "1");
+    request.linearLight = (fields[6] == "1");
+
+    return request.scaleFactor > 0.0f && method >= NEAREST_NEIGHBOR && method <= AREA_FILTER;
+}
+
+static std::string format_reply(fileStatus status, double seconds)
+{
+    char reply[64];
+    snprintf(reply, sizeof(reply), "%d%c%.3f\n", static_cast<int>(status), SERVER_FIELD_SEPARATOR, seconds * 1e3);
+    return reply;
+}
+
+static bool parse_reply(const std::string& line, fileStatus& status, double& seconds)
+{
+    const std::vector<std::string> fields = split_fields(line);
+    if (fields.size() != 2 || fields[0].empty())
+        return false;
+
+    status = static_cast<fileStatus>(std::atoi(fields[0].c_str()));
+    seconds = std::strtod(fields[1].c_str(), nullptr) / 1e3;
+    return true;
+}
+
+#ifndef _WIN32
+
+// ======================================================
+// Unix domain sockets
+
+static bool make_address(const std::string& socketPath, sockaddr_un& address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    return true;
+}
+
+static int connect_socket(const std::string& socketPath)
+{
+    sockaddr_un address;
+    if (!make_address(socketPath, address))
+        return -1;
+
+    const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0)
+        return -1;
+    if (connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(connection);
+        return -1;
+    }
+    return connection;
+}
+
+static bool send_all(int connection, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        // a peer that went away gives an error, not SIGPIPE
+        const ssize_t result = send(connection, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+/**
+* Reads the next line of a connection, without its LF
+*
+* @param pending - bytes read after the previous line, kept for the next call
+* @return false at the end of the connection, on an error or on a line longer than SERVER_MAX_REQUEST
+*/
+static bool read_line(int connection, std::string& pending, std::string& line)
+{
+    for (;;) {
+        const size_t end = pending.find('\n');
+        if (end != std::string::npos) {
+            line.assign(pending, 0, end);
+            pending.erase(0, end + 1);
+            return true;
+        }
+        if (pending.size() > SERVER_MAX_REQUEST)
+            return false;
+
+        char data[SERVER_READ_SIZE];
+        const ssize_t result = recv(connection, data, sizeof(data), 0);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        pending.append(data, static_cast<size_t>(result));
+    }
+}
+
+// The server does not run in the directory of the client
+static std::string absolute_path(const std::string& fileName)
+{
+    if (!fileName.empty() && fileName[0] == '/')
+        return fileName;
+
+    std::vector<char> directory(4096);
+    while (getcwd(directory.data(), directory.size()) == nullptr) {
+        if (errno != ERANGE)
+            return fileName;
+        directory.resize(directory.size() * 2);
+    }
+    return std::string(directory.data()) + "/" + fileName;
+}
+
+#endif
+
+// ======================================================
+
+ResizeServer::ResizeServer(std::shared_ptr<ThreadPool> sharedThreadPool)
+    : threadPool(sharedThreadPool ? sharedThreadPool : std::make_shared<ThreadPool>()), listenSocket(-1),
+      stopping(false), jobCount(0)
+{
+}
+
+ResizeServer::~ResizeServer()
+{
+#ifndef _WIN32
+    if (listenSocket >= 0) {
+        close(listenSocket);
+        unlink(socketPath.c_str());
+    }
+#endif
+}
+
+void ResizeServer::SetOutputCache(std::shared_ptr<OutputCache> cache)
+{
+    outputCache = cache;
+}
+
+#ifdef _WIN32
+
+bool ResizeServer::Listen(const std::string&)
+{
+    return false;
+}
+
+size_t ResizeServer::Serve()
+{
+    return 0;
+}
+
+bool ResizeServer::Submit(const std::string&, const t_resizerequest&, fileStatus&, double&)
+{
+    return false;
+}
+
+bool ResizeServer::Stop(const std::string&)
+{
+    return false;
+}
+
+void ResizeServer::ConnectionLoop()
+{
+}
+
+bool ResizeServer::ServeConnection(int, TGAProcessing&)
+{
+    return false;
+}
+
+void ResizeServer::RequestStop()
+{
+}
+
+#else
+
+bool ResizeServer::Listen(const std::string& newSocketPath)
+{
+    sockaddr_un address;
+    if (!make_address(newSocketPath, address))
+        return false;
+
+    // a socket file nobody answers on is left by a server that is gone
+    const int runningServer = connect_socket(newSocketPath);
+    if (runningServer >= 0) {
+        close(runningServer);
+        return false;
+    }
+    unlink(newSocketPath.c_str());
+
+    listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket < 0)
+        return false;
+    if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenSocket, SERVER_BACKLOG) != 0) {
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+
+    socketPath = newSocketPath;
+    return true;
+}
+
+size_t ResizeServer::Serve()
+{
+    if (listenSocket < 0)
+        return 0;
+
+    // one connection thread per pool thread, the bands of their jobs share the pool
+    std::vector<std::thread> connectionThreads;
+    for (size_t i = 0; i < threadPool->GetThreadCount(); i++) {
+        connectionThreads.emplace_back(&ResizeServer::ConnectionLoop, this);
+    }
+
+    for (;;) {
+        const int connection = accept(listenSocket, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            // RequestStop() shuts the socket down
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            close(connection);
+            break;
+        }
+        connections.push_back(connection);
+        condition.notify_one();
+    }
+
+    // the connections already accepted are still served
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (std::thread& connectionThread : connectionThreads) {
+        connectionThread.join();
+    }
+
+    close(listenSocket);
+    listenSocket = -1;
+    unlink(socketPath.c_str());
+    return jobCount;
+}
+
+bool ResizeServer::Submit(const std::string& serverSocketPath, const t_resizerequest& request, fileStatus& status, double& seconds)
+{
+    t_resizerequest absoluteRequest = request;
+    absoluteRequest.inputFileName = absolute_path(request.inputFileName);
+    absoluteRequest.outputFileName = absolute_path(request.outputFileName);
+    if (!is_protocol_safe(absoluteRequest.inputFileName) || !is_protocol_safe(absoluteRequest.outputFileName)) {
+        status = FILE_ERR_BAD_NAME;
+        seconds = 0.0;
+        return true;
+    }
+
+    const int connection = connect_socket(serverSocketPath);
+    if (connection < 0)
+        return false;
+
+    std::string pending;
+    std::string reply;
+    const bool replied = send_all(connection, format_request(absoluteRequest)) && read_line(connection, pending, reply);
+    close(connection);
+
+    return replied && parse_reply(reply, status, seconds);
+}
+
+bool ResizeServer::Stop(const std::string& serverSocketPath)
+{
+    const int connection = connect_socket(serverSocketPath);
+    if (connection < 0)
+        return false;
+
+    std::string pending;
+    std::string reply;
+    const bool replied = send_all(connection, "stop\n") && read_line(connection, pending, reply);
+    close(connection);
+    return replied;
+}
+
+void ResizeServer::ConnectionLoop()
+{
+    // the buffers of this thread are grown and faulted in before the first job
+    TGAProcessing tgaImageProcessing(threadPool);
+    tgaImageProcessing.SetOutputCache(outputCache);
+    tgaImageProcessing.ReserveBuffers(SERVER_RESERVE_SIZE, SERVER_RESERVE_SIZE, PIXELDEPTH_32BIT);
+
+    for (;;) {
+        int connection;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !connections.empty() || stopping; });
+            if (connections.empty())
+                return;
+            connection = connections.front();
+            connections.pop_front();
+        }
+
+        ServeConnection(connection, tgaImageProcessing);
+        close(connection);
+    }
+}
+
+// Runs the jobs of one connection until it is closed, false on a stop request
+bool ResizeServer::ServeConnection(int connection, TGAProcessing& tgaImageProcessing)
+{
+    std::string pending;
+    std::string line;
+    while (read_line(connection, pending, line)) {
+        const auto start = std::chrono::steady_clock::now();
+
+        if (line == "stop") {
+            RequestStop();
+            send_all(connection, format_reply(FILE_OK, 0.0));
+            return false;
+        }
+
+        t_resizerequest request;
+        fileStatus status = FILE_ERR_UNSUPPORTED;
+        if (parse_request(line, request)) {
+            tgaImageProcessing.SetRleOutput(request.rleOutput);
+            tgaImageProcessing.SetLinearLight(request.linearLight);
+            status = tgaImageProcessing.LoadImage(request.inputFileName);
+            if (FILE_OK == status) {
+                status = tgaImageProcessing.ResizeImageToFile(request.outputFileName, request.scaleFactor,
+                    request.interpolationMethod);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            jobCount++;
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!send_all(connection, format_reply(status, seconds)))
+            break;
+    }
+    return true;
+}
+
+void ResizeServer::RequestStop()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    // wakes accept() in Serve()
+    shutdown(listenSocket, SHUT_RDWR);
+}
+
+#endif
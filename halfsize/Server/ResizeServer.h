@@ -0,0 +1,120 @@
+#ifndef RESIZESERVER_H
+#define RESIZESERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "../Common/OutputCache.h"
+#include "../Common/Utilities.h"
+#include "../ThreadPool/ThreadPool.h"
+
+#define SERVER_BACKLOG          64      // connections waiting to be accepted
+#define SERVER_MAX_REQUEST      8192    // bytes of one request line
+#define SERVER_RESERVE_SIZE     2048    // width and height of the images the buffers of each connection thread start with
+#define SERVER_SOCKET_ENV       "HALFSIZE_SOCKET"   // environment variable naming the socket of a running server
+
+class TGAProcessing;
+
+/**
+One resize job sent to the server, the paths are absolute
+*/
+typedef struct
+{
+    std::string     inputFileName;
+    std::string     outputFileName;
+    float           scaleFactor;
+    resizeMethod    interpolationMethod;
+    bool            rleOutput;
+    bool            linearLight;
+} t_resizerequest;
+
+
+/**
+Resident resize server on a Unix domain socket
+Removes the process startup of one halfsize run per image: the thread pool, the TGAProcessing buffers and
+the caches stay warm from one job to the next. Each connection sends jobs, one request line each, and gets
+one reply line per job:
+
+    request:  resize <TAB> input <TAB> output <TAB> scale <TAB> method <TAB> rle (0/1) <TAB> linear (0/1) <LF>
+              stop <LF>
+    reply:    fileStatus <TAB> milliseconds <LF>
+
+Connections are served by as many threads as the pool has, each with its own TGAProcessing whose buffers
+are faulted in at startup. The row bands of every job run on the shared pool.
+Not available on Windows, Listen() and Submit() fail there.
+*/
+class ResizeServer
+{
+public:
+    /**
+    * @param sharedThreadPool - pool running the row bands of the jobs
+    */
+    explicit ResizeServer(std::shared_ptr<ThreadPool> sharedThreadPool);
+    ~ResizeServer();
+
+    ResizeServer(const ResizeServer&) = delete;
+    ResizeServer& operator=(const ResizeServer&) = delete;
+
+    /**
+    * Sets the output cache of every job, none by default
+    */
+    void SetOutputCache(std::shared_ptr<OutputCache> cache);
+
+    /**
+    * Creates the socket, a stale socket file left by a server that is gone is replaced
+    *
+    * @param socketPath - path of the socket file
+    * @return false if the socket cannot be created or another server is listening on it
+    */
+    bool Listen(const std::string& socketPath);
+
+    /**
+    * Serves connections until a stop request, then removes the socket file
+    *
+    * @return number of jobs run
+    */
+    size_t Serve();
+
+    /**
+    * Runs one job on a server, relative paths are made absolute first
+    * Paths holding a tab or a line break, the separators of the protocol, are not sent: the job fails with
+    * FILE_ERR_BAD_NAME without contacting the server.
+    *
+    * @param socketPath - path of the server socket
+    * @param request    - job to run
+    * @param status     - fileStatus of the job
+    * @param seconds    - time the server took, from the request to the reply
+    * @return false if there is no server on socketPath or it did not reply
+    */
+    static bool Submit(const std::string& socketPath, const t_resizerequest& request, fileStatus& status, double& seconds);
+
+    /**
+    * Asks a server to stop once the jobs it is running are done
+    *
+    * @return false if there is no server on socketPath
+    */
+    static bool Stop(const std::string& socketPath);
+
+private:
+    std::shared_ptr<ThreadPool>     threadPool;
+    std::shared_ptr<OutputCache>    outputCache;
+    std::string                     socketPath;
+    int                             listenSocket;
+
+    // accepted connections waiting for a connection thread
+    std::mutex                      mutex;
+    std::condition_variable         condition;
+    std::deque<int>                 connections;
+    bool                            stopping;
+    size_t                          jobCount;
+
+    void ConnectionLoop();
+    bool ServeConnection(int connection, TGAProcessing& tgaImageProcessing);
+    void RequestStop();
+};
+
+
+#endif	//RESIZESERVER_H
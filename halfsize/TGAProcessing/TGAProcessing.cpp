@@ -1,10 +1,63 @@
 #include "TGAProcessing.h"
 
+#include <algorithm>
+
+
+TGAProcessing::TGAProcessing()
+    : imageStatus(FILE_OK), threadPool(std::make_shared<ThreadPool>()), useMemoryMapping(true), prefetch(false),
+      parallelRead(false), directIo(false), rleOutput(false), linearLight(false), collectStats(false), stats(), rleDecoder(PIXELDEPTH_32BIT), cacheKey(0),
+      cacheKeyValid(false), resizePending(false), pendingMethod(BOX_FILTER_2X)
+{
+}
+
+TGAProcessing::TGAProcessing(std::shared_ptr<ThreadPool> sharedThreadPool)
+    : imageStatus(FILE_OK), threadPool(sharedThreadPool ? sharedThreadPool : std::make_shared<ThreadPool>()),
+      useMemoryMapping(true), prefetch(false), parallelRead(false), directIo(false), rleOutput(false), linearLight(false), collectStats(false), stats(),
+      rleDecoder(PIXELDEPTH_32BIT), cacheKey(0), cacheKeyValid(false), resizePending(false), pendingMethod(BOX_FILTER_2X)
+{
+}
+
+// Resizes a t_tgadata buffer, a new allocation is counted in the stats
+template <typename T, typename Allocator>
+void TGAProcessing::ResizeBuffer(std::vector<T, Allocator>& buffer, size_t size)
+{
+    const size_t capacity = buffer.capacity();
+    buffer.resize(size);
+    if (buffer.capacity() != capacity) {
+        TrackAllocation();
+    }
+}
 
 fileStatus TGAProcessing::LoadImage(const std::string& inputFileName)
 {
+    ResetStats();
+    cacheKeyValid = false;
+    resizePending = false;
+
+    // the buffers are kept for this image
+    if (tga.data.inputMapping) {
+        tga.data.inputMapping->Close();
+    }
+    tga.data.originalPixels = nullptr;
+
+    if (parallelRead) {
+        fileStatus result = ReadImageParallel(inputFileName, tga.header, tga.data);
+        // compressed images and files that cannot be opened take the paths below
+        if (FILE_ERR_OPEN != result) {
+            return result;
+        }
+    }
+
+    if (useMemoryMapping) {
+        fileStatus result = MapImage(inputFileName, tga.header, tga.data);
+        // files that cannot be mapped are read through the stream below
+        if (FILE_ERR_OPEN != result) {
+            return result;
+        }
+    }
+
     std::fstream imageFile;
-    imageFile.open(inputFileName, std::ios::in | std::ios::binary);
+    OpenFile(imageFile, inputFileName, std::ios::in | std::ios::binary, tga.data.inputFileBuffer);
 
 
     if (imageFile.is_open()) {
@@ -24,13 +77,37 @@ fileStatus TGAProcessing::LoadImage(const std::string& inputFileName)
 
 fileStatus TGAProcessing::SaveImage(const std::string& outputFileName)
 {
+    if (cacheKeyValid) {
+        if (FetchCachedOutput(outputFileName)) {
+            resizePending = false;
+            return FILE_OK;
+        }
+        if (resizePending) {
+            // evicted since ResizeImage, e.g. by another image of the batch
+            ResizeLoadedImage(pendingMethod);
+            resizePending = false;
+        }
+    }
+
+    OutputFile output(outputFileName, tga.data.outputTemporaryName);
     std::fstream file;
-    file.open(outputFileName, std::ios::out | std::ios::binary);
+    OpenFile(file, output.GetTemporaryName(), std::ios::out | std::ios::binary, tga.data.outputFileBuffer);
 
     if (file.is_open())
     {
         WriteImage(file, tga.header, tga.data);
+
+        // the last buffered bytes are written on close
+        StageTimer writeTimer(StageSeconds(stats.writeSeconds));
         file.close();
+        const bool written = !file.fail() && output.Commit();
+        writeTimer.Stop();
+        if (!written)
+            return FILE_ERR_OPEN;
+
+        if (cacheKeyValid) {
+            StoreCachedOutput(outputFileName);
+        }
         return FILE_OK;
     }
     else {
@@ -38,113 +115,1026 @@ fileStatus TGAProcessing::SaveImage(const std::string& outputFileName)
     }
 }
 
+void TGAProcessing::OpenFile(std::fstream& file, const std::string& fileName, std::ios::openmode mode, std::vector<char>& buffer)
+{
+    // the stream uses the kept buffer instead of allocating one on open, it must be set before opening
+    if (buffer.size() < FILE_BUFFER_SIZE) {
+        ResizeBuffer(buffer, FILE_BUFFER_SIZE);
+    }
+    file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.open(fileName, mode);
+}
+
+fileStatus TGAProcessing::ReadHeader(std::fstream& imageFile, t_tgaheader& tgaHeader)
+{
+    StageTimer headerTimer(StageSeconds(stats.headerReadSeconds));
+
+    // Read Header, one read of all its fields
+    char headerData[TGA_HEADER_SIZE];
+    imageFile.read(headerData, TGA_HEADER_SIZE);
+    if (!imageFile)
+        return FILE_ERR_BAD_FORMAT;
+
+    ParseHeader(headerData, tgaHeader);
+
+    fileStatus result = CheckHeader(tgaHeader);
+    if (FILE_OK != result)
+        return result;
+
+    // skip the image ID field
+    imageFile.seekg(static_cast<unsigned char>(tgaHeader.idLength), std::ios::cur);
+    stats.bytesRead += TGA_HEADER_SIZE + static_cast<unsigned char>(tgaHeader.idLength);
+
+    return FILE_OK;
+}
+
 fileStatus TGAProcessing::ReadImage(std::fstream& imageFile, t_tgaheader& tgaHeader, t_tgadata& tgaData)
 {
-    // Read Header
-    imageFile.read(&tgaHeader.idLength, sizeof(tgaHeader.idLength));
-    imageFile.read(&tgaHeader.colourMapType, sizeof(tgaHeader.colourMapType));
-    imageFile.read(&tgaHeader.imageType, sizeof(tgaHeader.imageType));
-    imageFile.read((char*)(&tgaHeader.colourMapOrigin), sizeof(tgaHeader.colourMapOrigin));
-    imageFile.read((char*)(&tgaHeader.colourMapLength), sizeof(tgaHeader.colourMapLength));
-    imageFile.read(&tgaHeader.colourMapDepth, sizeof(tgaHeader.colourMapDepth));
-    imageFile.read((char*)(&tgaHeader.x_origin), sizeof(tgaHeader.x_origin));
-    imageFile.read((char*)(&tgaHeader.y_origin), sizeof(tgaHeader.y_origin));
-    imageFile.read((char*)(&tgaHeader.width), sizeof(tgaHeader.width));
-    imageFile.read((char*)(&tgaHeader.height), sizeof(tgaHeader.height));
-    imageFile.read(&tgaHeader.pixelDepth, sizeof(tgaHeader.pixelDepth));
-    imageFile.read(&tgaHeader.imageDescriptor, sizeof(tgaHeader.pixelDepth));
+    fileStatus result = ReadHeader(imageFile, tgaHeader);
+    if (FILE_OK != result)
+        return result;
+
+    // ======================================================
+
+    StageTimer payloadTimer(StageSeconds(stats.payloadReadSeconds));
+
+    const size_t pixelArea = (const size_t)(tgaHeader.width) * (const size_t)(tgaHeader.height);
+    const size_t bitDepth = BytesPerPixel(tgaHeader);
+    // pixel area * BGR values
+    const size_t pixelAreaBitSize = (pixelArea * bitDepth);
+    ResizeBuffer(tgaData.originalData, pixelAreaBitSize);
+
+    if (IsRunLengthEncoded(tgaHeader)) {
+        // Decode BGR Data, the stream is read in chunks
+        rleDecoder.SetBitDepth(bitDepth);
+        rleDecoder.SetInput(&imageFile);
+        const bool decoded = rleDecoder.Decode(tgaData.originalData.data(), pixelArea);
+        stats.bytesRead += rleDecoder.GetBytesRead();
+        if (!decoded)
+            return FILE_ERR_BAD_FORMAT;
+    }
+    else {
+        // Read BGR Data
+        imageFile.read(tgaData.originalData.data(), pixelAreaBitSize);
+        stats.bytesRead += static_cast<size_t>(imageFile.gcount());
+        if (!imageFile)
+            return FILE_ERR_BAD_FORMAT;
+    }
+
+    tgaData.originalPixels = tgaData.originalData.data();
 
+    return FILE_OK;
+}
+
+fileStatus TGAProcessing::MapImage(const std::string& inputFileName, t_tgaheader& tgaHeader, t_tgadata& tgaData)
+{
+    StageTimer headerTimer(StageSeconds(stats.headerReadSeconds));
+
+    // the mapping object is created once and reopened for every image
+    if (!tgaData.inputMapping) {
+        tgaData.inputMapping = std::make_unique<MappedFile>();
+    }
+    MappedFile* mapping = tgaData.inputMapping.get();
+    if (!mapping->OpenRead(inputFileName))
+        return FILE_ERR_OPEN;
+
+    if (mapping->GetSize() < TGA_HEADER_SIZE)
+        return FILE_ERR_BAD_FORMAT;
+
+    ParseHeader(mapping->GetData(), tgaHeader);
+
+    fileStatus result = CheckHeader(tgaHeader);
+    if (FILE_OK != result)
+        return result;
+
+    // pixel area * BGR values, after the header and the image ID field
+    const size_t pixelArea = (const size_t)(tgaHeader.width) * (const size_t)(tgaHeader.height);
+    const size_t bitDepth = BytesPerPixel(tgaHeader);
+    const size_t pixelOffset = TGA_HEADER_SIZE + static_cast<unsigned char>(tgaHeader.idLength);
+
+    if (mapping->GetSize() < pixelOffset)
+        return FILE_ERR_BAD_FORMAT;
+
+    stats.bytesRead += pixelOffset;
+    headerTimer.Stop();
+
+    if (IsRunLengthEncoded(tgaHeader)) {
+        StageTimer payloadTimer(StageSeconds(stats.payloadReadSeconds));
+
+        // compressed pixels are decoded once from the mapping, which is not needed afterwards
+        ResizeBuffer(tgaData.originalData, pixelArea * bitDepth);
+
+        rleDecoder.SetBitDepth(bitDepth);
+        rleDecoder.SetInput(mapping->GetData() + pixelOffset, mapping->GetSize() - pixelOffset);
+        const bool decoded = rleDecoder.Decode(tgaData.originalData.data(), pixelArea);
+        stats.bytesRead += rleDecoder.GetBytesRead();
+        mapping->Close();
+        if (!decoded)
+            return FILE_ERR_BAD_FORMAT;
+
+        tgaData.originalPixels = tgaData.originalData.data();
+        return FILE_OK;
+    }
+
+    if (mapping->GetSize() < pixelOffset + pixelArea * bitDepth)
+        return FILE_ERR_BAD_FORMAT;
+
+    // the pages are read by the resize kernels, the time goes to the interpolation
+    // unless they are prefetched here
+    stats.bytesRead += pixelArea * bitDepth;
+    tgaData.originalPixels = mapping->GetData() + pixelOffset;
+    if (prefetch) {
+        StageTimer payloadTimer(StageSeconds(stats.payloadReadSeconds));
+        mapping->Prefetch(pixelOffset, pixelArea * bitDepth);
+    }
+
+    return FILE_OK;
+}
+
+fileStatus TGAProcessing::ReadImageParallel(const std::string& inputFileName, t_tgaheader& tgaHeader, t_tgadata& tgaData)
+{
+    StageTimer headerTimer(StageSeconds(stats.headerReadSeconds));
+
+    // the file object is created once and reopened for every image
+    if (!tgaData.inputFile) {
+        tgaData.inputFile = std::make_unique<ChunkedFile>();
+    }
+    ChunkedFile* file = tgaData.inputFile.get();
+    if (!file->OpenRead(inputFileName, directIo))
+        return FILE_ERR_OPEN;
+
+    // direct reads cover whole blocks from the start of the file: the first one holds the header and is
+    // read into originalData, where the rest of the file follows it
+    const bool direct = file->IsDirect();
+    char headerData[TGA_HEADER_SIZE];
+    const char* header = headerData;
+    size_t headerBytes = 0;
+    if (direct) {
+        if (tgaData.originalData.size() < DIRECT_IO_ALIGNMENT) {
+            ResizeBuffer(tgaData.originalData, DIRECT_IO_ALIGNMENT);
+        }
+        headerBytes = file->Read(0, tgaData.originalData.data(), DIRECT_IO_ALIGNMENT);
+        header = tgaData.originalData.data();
+    }
+    else {
+        headerBytes = file->Read(0, headerData, TGA_HEADER_SIZE);
+    }
+
+    if (headerBytes < TGA_HEADER_SIZE) {
+        file->Close();
+        return FILE_ERR_BAD_FORMAT;
+    }
+
+    ParseHeader(header, tgaHeader);
+
+    fileStatus result = CheckHeader(tgaHeader);
+    if (FILE_OK != result || IsRunLengthEncoded(tgaHeader)) {
+        // compressed pixels are decoded front to back, from the mapping or the stream
+        file->Close();
+        return (FILE_OK != result) ? result : FILE_ERR_OPEN;
+    }
+
+    // pixel area * BGR values, after the header and the image ID field
+    const size_t pixelArea = (const size_t)(tgaHeader.width) * (const size_t)(tgaHeader.height);
+    const size_t pixelAreaBitSize = pixelArea * BytesPerPixel(tgaHeader);
+    const size_t pixelOffset = TGA_HEADER_SIZE + static_cast<unsigned char>(tgaHeader.idLength);
+
+    if (file->GetSize() < pixelOffset + pixelAreaBitSize) {
+        file->Close();
+        return FILE_ERR_BAD_FORMAT;
+    }
+
+    stats.bytesRead += pixelOffset;
+    headerTimer.Stop();
+
+    StageTimer payloadTimer(StageSeconds(stats.payloadReadSeconds));
+
+    size_t bytesRead = 0;
+    if (direct) {
+        // the last block is rounded up, the read stops at the end of the file
+        const size_t blocksEnd = (pixelOffset + pixelAreaBitSize + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        if (tgaData.originalData.size() < blocksEnd) {
+            ResizeBuffer(tgaData.originalData, blocksEnd);
+        }
+        bytesRead = headerBytes - pixelOffset;
+        if (blocksEnd > DIRECT_IO_ALIGNMENT) {
+            bytesRead += file->ReadParallel(*threadPool, DIRECT_IO_ALIGNMENT, tgaData.originalData.data() + DIRECT_IO_ALIGNMENT,
+                blocksEnd - DIRECT_IO_ALIGNMENT);
+        }
+        tgaData.originalPixels = tgaData.originalData.data() + pixelOffset;
+    }
+    else {
+        ResizeBuffer(tgaData.originalData, pixelAreaBitSize);
+        bytesRead = file->ReadParallel(*threadPool, pixelOffset, tgaData.originalData.data(), pixelAreaBitSize);
+        tgaData.originalPixels = tgaData.originalData.data();
+    }
+    file->Close();
+
+    if (bytesRead < pixelAreaBitSize) {
+        tgaData.originalPixels = nullptr;
+        return FILE_ERR_BAD_FORMAT;
+    }
+
+    stats.bytesRead += pixelAreaBitSize;
+    return FILE_OK;
+}
+
+fileStatus TGAProcessing::LoadRegion(const std::string& inputFileName, const t_region& region)
+{
+    ResetStats();
+    cacheKeyValid = false;
+    resizePending = false;
+
+    if (!tga.data.inputMapping) {
+        tga.data.inputMapping = std::make_unique<MappedFile>();
+    }
+    MappedFile* mapping = tga.data.inputMapping.get();
+    mapping->Close();
+    tga.data.originalPixels = nullptr;
+
+    // the header and the rows come from the mapping, or from the stream when the file cannot be mapped
+    std::fstream imageFile;
+    const bool mapped = useMemoryMapping && mapping->OpenRead(inputFileName);
+    if (mapped) {
+        StageTimer headerTimer(StageSeconds(stats.headerReadSeconds));
+
+        if (mapping->GetSize() < TGA_HEADER_SIZE)
+            return FILE_ERR_BAD_FORMAT;
+        ParseHeader(mapping->GetData(), tga.header);
+        fileStatus result = CheckHeader(tga.header);
+        if (FILE_OK != result)
+            return result;
+        stats.bytesRead += TGA_HEADER_SIZE + static_cast<unsigned char>(tga.header.idLength);
+    }
+    else {
+        // unbuffered: a buffered stream would refill its whole buffer after each seek, the region rows are read exactly
+        imageFile.rdbuf()->pubsetbuf(nullptr, 0);
+        imageFile.open(inputFileName, std::ios::in | std::ios::binary);
+        if (!imageFile.is_open())
+            return FILE_ERR_OPEN;
+        fileStatus result = ReadHeader(imageFile, tga.header);
+        if (FILE_OK != result)
+            return result;
+    }
+
+    const int width = tga.header.width;
+    const int height = tga.header.height;
+    if (region.width < 1 || region.height < 1 || region.x < 0 || region.y < 0 ||
+        region.x > width - region.width || region.y > height - region.height)
+        return FILE_ERR_BAD_REGION;
+
+    // the region is given as displayed, the file rows run bottom-up and the columns right to left unless the bits say otherwise
+    const int fileRow = (tga.header.imageDescriptor & TGA_DESCRIPTOR_TOP_DOWN) ? region.y : height - region.y - region.height;
+    const int fileColumn = (tga.header.imageDescriptor & TGA_DESCRIPTOR_RIGHT_TO_LEFT) ? width - region.x - region.width : region.x;
+
+    StageTimer payloadTimer(StageSeconds(stats.payloadReadSeconds));
+
+    const size_t bitDepth = BytesPerPixel(tga.header);
+    const size_t rowSize = static_cast<size_t>(width) * bitDepth;
+    const size_t regionRowSize = static_cast<size_t>(region.width) * bitDepth;
+    const size_t columnOffset = static_cast<size_t>(fileColumn) * bitDepth;
+    const size_t pixelOffset = TGA_HEADER_SIZE + static_cast<unsigned char>(tga.header.idLength);
+
+    ResizeBuffer(tga.data.originalData, regionRowSize * static_cast<size_t>(region.height));
+    char* regionData = tga.data.originalData.data();
+
+    if (IsRunLengthEncoded(tga.header)) {
+        // compressed rows cannot be seeked to: the rows before the region are decoded and dropped, the ones after are not read
+        if (tga.data.bandData.size() < rowSize) {
+            ResizeBuffer(tga.data.bandData, rowSize);
+        }
+        rleDecoder.SetBitDepth(bitDepth);
+        if (mapped) {
+            if (mapping->GetSize() < pixelOffset)
+                return FILE_ERR_BAD_FORMAT;
+            rleDecoder.SetInput(mapping->GetData() + pixelOffset, mapping->GetSize() - pixelOffset);
+        }
+        else {
+            rleDecoder.SetInput(&imageFile);
+        }
+
+        for (int row = 0; row < fileRow + region.height; row++) {
+            if (!rleDecoder.Decode(tga.data.bandData.data(), static_cast<size_t>(width)))
+                return FILE_ERR_BAD_FORMAT;
+            if (row >= fileRow) {
+                memcpy(regionData + static_cast<size_t>(row - fileRow) * regionRowSize,
+                    tga.data.bandData.data() + columnOffset, regionRowSize);
+            }
+        }
+        stats.bytesRead += rleDecoder.GetBytesRead();
+    }
+    else {
+        if (mapped && mapping->GetSize() < pixelOffset + rowSize * static_cast<size_t>(height))
+            return FILE_ERR_BAD_FORMAT;
+
+        // only the pages of the region are read from the mapping
+        for (int row = 0; row < region.height; row++) {
+            const size_t offset = pixelOffset + static_cast<size_t>(fileRow + row) * rowSize + columnOffset;
+            char* regionRow = regionData + static_cast<size_t>(row) * regionRowSize;
+            if (mapped) {
+                memcpy(regionRow, mapping->GetData() + offset, regionRowSize);
+                continue;
+            }
+
+            // rows of the full width follow one another, narrower ones skip the other columns
+            if (row == 0 || regionRowSize != rowSize) {
+                imageFile.seekg(static_cast<std::streamoff>(offset));
+            }
+            imageFile.read(regionRow, regionRowSize);
+            if (!imageFile)
+                return FILE_ERR_BAD_FORMAT;
+        }
+        stats.bytesRead += regionRowSize * static_cast<size_t>(region.height);
+    }
+
+    // the region is copied, it stands for the loaded image from now on
+    mapping->Close();
+    tga.header.width = static_cast<unsigned short>(region.width);
+    tga.header.height = static_cast<unsigned short>(region.height);
+    tga.data.originalPixels = regionData;
+
+    return FILE_OK;
+}
+
+fileStatus TGAProcessing::ResizeRegion(const std::string& inputFileName, const std::string& outputFileName,
+    const t_region& region, int newWidth, int newHeight, resizeMethod interpolationMethod)
+{
+    fileStatus result = LoadRegion(inputFileName, region);
+    if (FILE_OK != result)
+        return result;
+
+    ResizeImage(newWidth, newHeight, interpolationMethod);
+    return SaveImage(outputFileName);
+}
+
+fileStatus TGAProcessing::CheckHeader(const t_tgaheader& tgaHeader)
+{
     if (tgaHeader.colourMapType != 0)
         return FILE_ERR_UNSUPPORTED;
-    if (tgaHeader.imageType != 2)
+    if (tgaHeader.imageType != TGA_TYPE_TRUECOLOR && tgaHeader.imageType != TGA_TYPE_GREY &&
+        tgaHeader.imageType != TGA_TYPE_RLE_TRUECOLOR && tgaHeader.imageType != TGA_TYPE_RLE_GREY)
         return FILE_ERR_UNSUPPORTED;
     if ((tgaHeader.width < 1) || (tgaHeader.height < 1))
         return FILE_ERR_BAD_FORMAT;
-    if (tgaHeader.pixelDepth > 32)
+
+    // greyscale is 8 bit, true colour 15/16 (A1R5G5B5), 24 or 32 bit, every other depth has no pixelFormat
+    const bool greyscale = (tgaHeader.imageType == TGA_TYPE_GREY || tgaHeader.imageType == TGA_TYPE_RLE_GREY);
+    const int pixelDepth = static_cast<unsigned char>(tgaHeader.pixelDepth);
+    if (greyscale && pixelDepth != 8)
+        return FILE_ERR_UNSUPPORTED;
+    if (!greyscale && pixelDepth != 15 && pixelDepth != 16 && pixelDepth != 24 && pixelDepth != 32)
         return FILE_ERR_UNSUPPORTED;
 
-    // ======================================================
+    return FILE_OK;
+}
 
-    const size_t pixelArea = (const size_t)(tgaHeader.width) * (const size_t)(tgaHeader.height);
-    const size_t bitDepth = (tgaHeader.pixelDepth / IMAGEBIT_SIZE);
-    // pixel area * BGR values
-    const size_t pixelAreaBitSize = (pixelArea * bitDepth);
-    tgaData.originalData = std::make_unique<char[]>(pixelAreaBitSize);
+pixelFormat TGAProcessing::PixelFormat(const t_tgaheader& tgaHeader)
+{
+    switch (static_cast<unsigned char>(tgaHeader.pixelDepth)) {
+    case 8:  return PIXELFORMAT_GREY8;
+    case 15:
+    case 16: return PIXELFORMAT_RGB555;
+    case 24: return PIXELFORMAT_BGR24;
+    default: return PIXELFORMAT_BGRA32;
+    }
+}
 
-    // Read BGR Data
-    imageFile.read(tgaData.originalData.get(), pixelAreaBitSize);
+size_t TGAProcessing::BytesPerPixel(const t_tgaheader& tgaHeader)
+{
+    // a 15 bit pixel takes 2 bytes like a 16 bit one
+    return pixel_format_bytes(PixelFormat(tgaHeader));
+}
 
+// Kernels of the non-separable methods instantiated for one pixel format
+template <pixelFormat format>
+static t_resizekernel select_kernel(resizeMethod interpolationMethod)
+{
+    switch (interpolationMethod) {
+    case BOX_FILTER_2X:     return &box_filter_half<format>;
+    case NEAREST_NEIGHBOR:  return &nn_interpolation_interleaved<format>;
+    case BILINEAR_INTERPOL: return &bilinear_interpolation_interleaved<format>;
+    default:                return nullptr;
+    }
+}
 
-    return FILE_OK;
+// Kernels in linear light, nearest neighbour copies pixels and has no linear version
+template <pixelFormat format>
+static t_resizekernel select_linear_kernel(resizeMethod interpolationMethod)
+{
+    switch (interpolationMethod) {
+    case BOX_FILTER_2X:     return &box_filter_half_linear<format>;
+    case NEAREST_NEIGHBOR:  return &nn_interpolation_interleaved<format>;
+    case BILINEAR_INTERPOL: return &bilinear_interpolation_linear<format>;
+    default:                return nullptr;
+    }
+}
+
+t_resizekernel TGAProcessing::SelectKernel(resizeMethod interpolationMethod, pixelFormat format, bool linearLight)
+{
+    if (linearLight && linear_light_supported(format)) {
+        switch (format) {
+        case PIXELFORMAT_GREY8: return select_linear_kernel<PIXELFORMAT_GREY8>(interpolationMethod);
+        case PIXELFORMAT_BGR24: return select_linear_kernel<PIXELFORMAT_BGR24>(interpolationMethod);
+        default:                return select_linear_kernel<PIXELFORMAT_BGRA32>(interpolationMethod);
+        }
+    }
+
+    switch (format) {
+    case PIXELFORMAT_GREY8:  return select_kernel<PIXELFORMAT_GREY8>(interpolationMethod);
+    case PIXELFORMAT_RGB555: return select_kernel<PIXELFORMAT_RGB555>(interpolationMethod);
+    case PIXELFORMAT_BGR24:  return select_kernel<PIXELFORMAT_BGR24>(interpolationMethod);
+    default:                 return select_kernel<PIXELFORMAT_BGRA32>(interpolationMethod);
+    }
+}
+
+t_mipkernel TGAProcessing::SelectMipKernel(pixelFormat format, bool linearLight)
+{
+    if (linearLight && linear_light_supported(format)) {
+        switch (format) {
+        case PIXELFORMAT_GREY8: return &box_filter_mip_linear<PIXELFORMAT_GREY8>;
+        case PIXELFORMAT_BGR24: return &box_filter_mip_linear<PIXELFORMAT_BGR24>;
+        default:                return &box_filter_mip_linear<PIXELFORMAT_BGRA32>;
+        }
+    }
+
+    switch (format) {
+    case PIXELFORMAT_GREY8:  return &box_filter_mip<PIXELFORMAT_GREY8>;
+    case PIXELFORMAT_RGB555: return &box_filter_mip<PIXELFORMAT_RGB555>;
+    case PIXELFORMAT_BGR24:  return &box_filter_mip<PIXELFORMAT_BGR24>;
+    default:                 return &box_filter_mip<PIXELFORMAT_BGRA32>;
+    }
+}
+
+void TGAProcessing::ParseHeader(const char* headerData, t_tgaheader& tgaHeader)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(headerData);
+
+    // 16 bit fields are little-endian
+    tgaHeader.idLength        = static_cast<char>(bytes[0]);
+    tgaHeader.colourMapType   = static_cast<char>(bytes[1]);
+    tgaHeader.imageType       = static_cast<char>(bytes[2]);
+    tgaHeader.colourMapOrigin = static_cast<short>(bytes[3] | (bytes[4] << 8));
+    tgaHeader.colourMapLength = static_cast<short>(bytes[5] | (bytes[6] << 8));
+    tgaHeader.colourMapDepth  = static_cast<char>(bytes[7]);
+    tgaHeader.x_origin        = static_cast<short>(bytes[8] | (bytes[9] << 8));
+    tgaHeader.y_origin        = static_cast<short>(bytes[10] | (bytes[11] << 8));
+    tgaHeader.width           = static_cast<unsigned short>(bytes[12] | (bytes[13] << 8));
+    tgaHeader.height          = static_cast<unsigned short>(bytes[14] | (bytes[15] << 8));
+    tgaHeader.pixelDepth      = static_cast<char>(bytes[16]);
+    tgaHeader.imageDescriptor = static_cast<char>(bytes[17]);
+}
+
+void TGAProcessing::SerializeHeader(const t_tgaheader& tgaHeader, int width, int height, bool runLengthEncoded, char* headerData)
+{
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(headerData);
+
+    // the output is compressed or not whatever the input was
+    const bool greyscale = (tgaHeader.imageType == TGA_TYPE_GREY || tgaHeader.imageType == TGA_TYPE_RLE_GREY);
+    const int imageType = greyscale ? (runLengthEncoded ? TGA_TYPE_RLE_GREY : TGA_TYPE_GREY)
+                                    : (runLengthEncoded ? TGA_TYPE_RLE_TRUECOLOR : TGA_TYPE_TRUECOLOR);
+
+    // the image ID field is not written
+    bytes[0]  = 0;
+    bytes[1]  = static_cast<unsigned char>(tgaHeader.colourMapType);
+    bytes[2]  = static_cast<unsigned char>(imageType);
+    bytes[3]  = static_cast<unsigned char>(tgaHeader.colourMapOrigin & 0xFF);
+    bytes[4]  = static_cast<unsigned char>((tgaHeader.colourMapOrigin >> 8) & 0xFF);
+    bytes[5]  = static_cast<unsigned char>(tgaHeader.colourMapLength & 0xFF);
+    bytes[6]  = static_cast<unsigned char>((tgaHeader.colourMapLength >> 8) & 0xFF);
+    bytes[7]  = static_cast<unsigned char>(tgaHeader.colourMapDepth);
+    bytes[8]  = static_cast<unsigned char>(tgaHeader.x_origin & 0xFF);
+    bytes[9]  = static_cast<unsigned char>((tgaHeader.x_origin >> 8) & 0xFF);
+    bytes[10] = static_cast<unsigned char>(tgaHeader.y_origin & 0xFF);
+    bytes[11] = static_cast<unsigned char>((tgaHeader.y_origin >> 8) & 0xFF);
+    bytes[12] = static_cast<unsigned char>(width & 0xFF);
+    bytes[13] = static_cast<unsigned char>((width >> 8) & 0xFF);
+    bytes[14] = static_cast<unsigned char>(height & 0xFF);
+    bytes[15] = static_cast<unsigned char>((height >> 8) & 0xFF);
+    bytes[16] = static_cast<unsigned char>(tgaHeader.pixelDepth);
+    bytes[17] = static_cast<unsigned char>(tgaHeader.imageDescriptor);
+}
+
+bool TGAProcessing::IsRunLengthEncoded(const t_tgaheader& tgaHeader)
+{
+    return tgaHeader.imageType == TGA_TYPE_RLE_TRUECOLOR || tgaHeader.imageType == TGA_TYPE_RLE_GREY;
 }
 
 void TGAProcessing::ResizeImage(float scaleFactor, resizeMethod interpolationMethod)
 {
-    const size_t bitDepth = (tga.header.pixelDepth / IMAGEBIT_SIZE);
-    const int newHeight   = static_cast<const int>(static_cast<float>(tga.header.height) / scaleFactor);
-    const int newWidth    = static_cast<const int>(static_cast<float>(tga.header.width) / scaleFactor);
-    const int newArea     = newHeight * newWidth;
+    int newWidth, newHeight;
+    ResizedSize(tga.header.width, tga.header.height, scaleFactor, newWidth, newHeight);
+    ResizeToSize(newWidth, newHeight, SelectMethod(tga.header.width, tga.header.height, newWidth, newHeight, interpolationMethod));
+}
 
-    // initialize colour buffers for the interpolation
-    tga.data.blueChnResized.assign(newArea, sizeof(char));
-    tga.data.greenChnResized.assign(newArea, sizeof(char));
-    tga.data.redChnResized.assign(newArea, sizeof(char));
-    tga.data.alphaChnResized.assign(newArea, sizeof(char));
-    tga.data.resizedData = std::make_unique<char[]>(newArea * bitDepth);
+void TGAProcessing::ResizeImage(int newWidth, int newHeight, resizeMethod interpolationMethod)
+{
+    newWidth = (newWidth < 1) ? 1 : newWidth;
+    newHeight = (newHeight < 1) ? 1 : newHeight;
+    ResizeToSize(newWidth, newHeight, SelectMethod(tga.header.width, tga.header.height, newWidth, newHeight, interpolationMethod));
+}
 
-    // ======================================================
-    // De-interleave input stream to different colour channels
-    deinterleave_rgba_channels(tga.data.originalData.get(), tga.header.width, tga.header.height, tga.header.pixelDepth,
-        tga.data.blueChn, tga.data.greenChn, tga.data.redChn, tga.data.alphaChn, BGRA);
+// Resizes the loaded image with a method already checked against the size, unless the output cache has it
+void TGAProcessing::ResizeToSize(int newWidth, int newHeight, resizeMethod interpolationMethod)
+{
+    tga.data.resizedWidth = newWidth;
+    tga.data.resizedHeight = newHeight;
 
+    resizePending = false;
+    if (outputCache) {
+        cacheKey = CacheKey(newWidth, newHeight, interpolationMethod);
+        cacheKeyValid = true;
+        if (outputCache->Contains(cacheKey)) {
+            resizePending = true;
+            pendingMethod = interpolationMethod;
+            return;
+        }
+    }
 
-    // ======================================================
-    // Interpolation of original pixel data to new image size
-    if (NEAREST_NEIGHBOR == interpolationMethod) {
+    ResizeLoadedImage(interpolationMethod);
+}
+
+// Resizes the loaded image to resizedWidth x resizedHeight
+void TGAProcessing::ResizeLoadedImage(resizeMethod interpolationMethod)
+{
+    const int newWidth = tga.data.resizedWidth;
+    const int newHeight = tga.data.resizedHeight;
+    const size_t newArea  = static_cast<size_t>(newHeight) * static_cast<size_t>(newWidth);
+
+    const size_t bitDepth = BytesPerPixel(tga.header);
+
+    ResizeBuffer(tga.data.resizedData, newArea * bitDepth);
+    ResizePixels(tga.data.originalPixels, 0, tga.header.width, tga.header.height, tga.header.width * bitDepth,
+        tga.data.resizedData.data(), newWidth, newHeight, newWidth * bitDepth, 0, newHeight, PixelFormat(tga.header),
+        interpolationMethod);
+}
+
+fileStatus TGAProcessing::ResizeImageToFile(const std::string& outputFileName, float scaleFactor, resizeMethod interpolationMethod)
+{
+    // the size of an encoded file is not known before encoding, it cannot be mapped up front
+    if (!useMemoryMapping || rleOutput) {
+        ResizeImage(scaleFactor, interpolationMethod);
+        return SaveImage(outputFileName);
+    }
+
+    const size_t bitDepth = BytesPerPixel(tga.header);
+    int newWidth, newHeight;
+    ResizedSize(tga.header.width, tga.header.height, scaleFactor, newWidth, newHeight);
+    const size_t newArea  = static_cast<size_t>(newHeight) * static_cast<size_t>(newWidth);
+    const resizeMethod method = SelectMethod(tga.header.width, tga.header.height, newWidth, newHeight, interpolationMethod);
+
+    if (outputCache) {
+        cacheKey = CacheKey(newWidth, newHeight, method);
+        cacheKeyValid = true;
+        if (FetchCachedOutput(outputFileName))
+            return FILE_OK;
+    }
+
+    StageTimer writeTimer(StageSeconds(stats.writeSeconds));
+
+    // a new file, the output path may be the input mapped in tga.data.inputMapping
+    OutputFile output(outputFileName, tga.data.outputTemporaryName);
+    MappedFile outputMapping;
+    if (!outputMapping.CreateWrite(output.GetTemporaryName(), TGA_HEADER_SIZE + newArea * bitDepth))
+        return FILE_ERR_OPEN;
+
+    SerializeHeader(tga.header, newWidth, newHeight, false, outputMapping.GetData());
+    stats.bytesWritten += TGA_HEADER_SIZE + newArea * bitDepth;
+    writeTimer.Stop();
+
+    // the kernels write straight into the mapped output file, the time goes to the interpolation
+    ResizePixels(tga.data.originalPixels, 0, tga.header.width, tga.header.height, tga.header.width * bitDepth,
+        outputMapping.GetData() + TGA_HEADER_SIZE, newWidth, newHeight, newWidth * bitDepth, 0, newHeight, PixelFormat(tga.header),
+        method);
+
+    StageTimer unmapTimer(StageSeconds(stats.writeSeconds));
+    outputMapping.Close();
+    const bool written = output.Commit();
+    unmapTimer.Stop();
+    if (!written)
+        return FILE_ERR_OPEN;
+
+    if (outputCache) {
+        StoreCachedOutput(outputFileName);
+    }
+    return FILE_OK;
+}
+
+fileStatus TGAProcessing::ResizeImageBuffer(const t_imagebuffer& source, const t_imagebuffer& target, resizeMethod interpolationMethod)
+{
+    if (source.format != target.format)
+        return FILE_ERR_UNSUPPORTED;
+
+    const size_t bitDepth = pixel_format_bytes(source.format);
+    const t_imagebuffer* buffers[] = { &source, &target };
+    for (const t_imagebuffer* buffer : buffers) {
+        if (buffer->pixels == nullptr || buffer->width < 1 || buffer->height < 1 ||
+            buffer->rowStride < static_cast<size_t>(buffer->width) * bitDepth)
+            return FILE_ERR_BAD_BUFFER;
+    }
+
+    ResizePixels(source.pixels, 0, source.width, source.height, source.rowStride, target.pixels, target.width, target.height,
+        target.rowStride, 0, target.height, source.format,
+        SelectMethod(source.width, source.height, target.width, target.height, interpolationMethod));
+    return FILE_OK;
+}
+
+void TGAProcessing::ResizePixels(const char* originalPixels, int firstSourceRow, int width, int height, size_t rowStride,
+    char* resizedPixels, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow, pixelFormat format,
+    resizeMethod interpolationMethod)
+{
+    StageTimer interpolationTimer(StageSeconds(stats.interpolationSeconds));
 
-        nn_interpolation(scaleFactor, tga.header.width, tga.header.height, tga.header.pixelDepth,
-            tga.data.blueChn, tga.data.greenChn, tga.data.redChn, tga.data.alphaChn,
-            tga.data.blueChnResized, tga.data.greenChnResized, tga.data.redChnResized, tga.data.alphaChnResized);
+    // the taps are computed and the kernel of the pixel format is picked here, before the threads share them
+    const Resampler* bandResampler = nullptr;
+    if (Resampler::IsSeparable(interpolationMethod)) {
+        bandResampler = &GetResampler(interpolationMethod, width, height, newWidth, newHeight, format);
     }
-    else if (BILINEAR_INTERPOL == interpolationMethod) {
+    const t_resizekernel kernel = SelectKernel(interpolationMethod, format, linearLight);
 
-        bilinear_interpolation(scaleFactor, tga.header.width, tga.header.height, tga.header.pixelDepth,
-            tga.data.blueChn, tga.data.greenChn, tga.data.redChn, tga.data.alphaChn,
-            tga.data.blueChnResized, tga.data.greenChnResized, tga.data.redChnResized, tga.data.alphaChnResized);
+    // Output rows are independent, each band is computed by one thread
+    // Rounding the band size up keeps the band count, and the queue of the pool, within threads * BANDS_PER_THREAD
+    const int threadCount = static_cast<int>(threadPool->GetThreadCount());
+    const int maxBands = threadCount * BANDS_PER_THREAD;
+    int bandSize = (endRow - firstRow + maxBands - 1) / maxBands;
+    if (bandSize < MIN_ROWS_PER_BAND) {
+        bandSize = MIN_ROWS_PER_BAND;
     }
 
     // ======================================================
-    // Interleave different colour channels to output stream [1, (width*height) pixels]
-    interleave_rgba_channels(tga.data.resizedData.get(), tga.header.width, tga.header.height, tga.header.pixelDepth,
-        tga.data.blueChnResized, tga.data.greenChnResized, tga.data.redChnResized, tga.data.alphaChnResized,
-                            scaleFactor, BGRA);
+    // Interpolation of the interleaved BGRA data straight to the new image size
+    threadPool->ParallelFor(endRow - firstRow, bandSize, [&](int bandBegin, int bandEnd) {
+        char* resizedBand = resizedPixels + static_cast<size_t>(bandBegin) * newRowStride;
+        bandBegin += firstRow;
+        bandEnd += firstRow;
+
+        if (kernel != nullptr) {
+
+            kernel(originalPixels, firstSourceRow, width, height, rowStride, resizedBand, newWidth, newHeight, newRowStride,
+                bandBegin, bandEnd);
+        }
+        else if (bandResampler != nullptr) {
+
+            bandResampler->Resize(originalPixels, firstSourceRow, rowStride, resizedBand, newRowStride, bandBegin, bandEnd);
+        }
+    });
+}
+
+const Resampler& TGAProcessing::GetResampler(resizeMethod interpolationMethod, int width, int height, int newWidth, int newHeight,
+    pixelFormat format)
+{
+    if (!resampler) {
+        resampler = std::make_unique<Resampler>(interpolationMethod, width, height, newWidth, newHeight, format, linearLight);
+    }
+    else if (!resampler->Matches(interpolationMethod, width, height, newWidth, newHeight, format, linearLight)) {
+        resampler->Configure(interpolationMethod, width, height, newWidth, newHeight, format, linearLight);
+    }
+    return *resampler;
+}
+
+void TGAProcessing::SourceRows(resizeMethod interpolationMethod, int firstRow, int endRow, int newWidth, int newHeight,
+    int& firstSourceRow, int& lastSourceRow)
+{
+    if (Resampler::IsSeparable(interpolationMethod)) {
+        GetResampler(interpolationMethod, tga.header.width, tga.header.height, newWidth, newHeight, PixelFormat(tga.header)).SourceRows(firstRow, endRow, firstSourceRow, lastSourceRow);
+        return;
+    }
+
+    int unused;
+    source_rows_for_output_row(interpolationMethod, firstRow, tga.header.height, newHeight, firstSourceRow, unused);
+    source_rows_for_output_row(interpolationMethod, endRow - 1, tga.header.height, newHeight, unused, lastSourceRow);
+}
+
+resizeMethod TGAProcessing::SelectMethod(int width, int height, int newWidth, int newHeight, resizeMethod interpolationMethod)
+{
+    // the box filter only covers the exact halfsize case, not a side of one pixel kept at one pixel
+    if (BOX_FILTER_2X == interpolationMethod && (newWidth != width / 2 || newHeight != height / 2)) {
+        return BILINEAR_INTERPOL;
+    }
+    return interpolationMethod;
+}
+
+fileStatus TGAProcessing::ResizeImageStreaming(const std::string& inputFileName, const std::string& outputFileName,
+    float scaleFactor, resizeMethod interpolationMethod, int bandRows)
+{
+    ResetStats();
+    cacheKeyValid = false;
+    resizePending = false;
+
+    std::fstream imageFile;
+    OpenFile(imageFile, inputFileName, std::ios::in | std::ios::binary, tga.data.inputFileBuffer);
+    if (!imageFile.is_open())
+        return FILE_ERR_OPEN;
+
+    fileStatus result = ReadHeader(imageFile, tga.header);
+    if (FILE_OK != result)
+        return result;
+
+    // the pixel data is held in tga.data.bandData only, the whole image buffer is released
+    decltype(tga.data.originalData)().swap(tga.data.originalData);
+    if (tga.data.inputMapping) {
+        tga.data.inputMapping->Close();
+    }
+    tga.data.originalPixels = nullptr;
+
+    if (bandRows < 1) {
+        bandRows = 1;
+    }
+
+    const size_t bitDepth = BytesPerPixel(tga.header);
+    const int width       = tga.header.width;
+    int newWidth, newHeight;
+    ResizedSize(width, tga.header.height, scaleFactor, newWidth, newHeight);
+    interpolationMethod = SelectMethod(width, tga.header.height, newWidth, newHeight, interpolationMethod);
+    const size_t rowSize  = static_cast<size_t>(tga.header.width) * bitDepth;
+    const size_t newRowSize = static_cast<size_t>(newWidth) * bitDepth;
+
+    // the input is read until the last band, it may be the output path
+    OutputFile output(outputFileName, tga.data.outputTemporaryName);
+    std::fstream outputFile;
+    OpenFile(outputFile, output.GetTemporaryName(), std::ios::out | std::ios::binary, tga.data.outputFileBuffer);
+    if (!outputFile.is_open())
+        return FILE_ERR_OPEN;
+
+    WriteHeader(outputFile, newWidth, newHeight);
+
+    // Source rows held in the band buffer: [windowFirst, windowEnd)
+    // Rows shared by two consecutive bands are moved to the front instead of being read again
+    int windowFirst = 0;
+    int windowEnd = 0;
+    int nextRow = 0;
+    const std::streamoff pixelOffset = imageFile.tellg();
+
+    // compressed rows are decoded in order as the bands need them
+    const bool runLengthEncoded = IsRunLengthEncoded(tga.header);
+    RleDecoder& decoder = rleDecoder;
+    decoder.SetBitDepth(bitDepth);
+    if (runLengthEncoded) {
+        decoder.SetInput(&imageFile);
+    }
+    else {
+        decoder.SetInput(nullptr, 0);
+    }
+
+    ResizeBuffer(tga.data.resizedBandData, static_cast<size_t>(bandRows) * newRowSize);
+
+    for (int firstRow = 0; firstRow < newHeight; firstRow += bandRows) {
+        const int endRow = (firstRow + bandRows < newHeight) ? firstRow + bandRows : newHeight;
+
+        int firstSourceRow, lastSourceRow;
+        SourceRows(interpolationMethod, firstRow, endRow, newWidth, newHeight, firstSourceRow, lastSourceRow);
+
+        const size_t bandSize = static_cast<size_t>(lastSourceRow - firstSourceRow + 1) * rowSize;
+        if (tga.data.bandData.size() < bandSize) {
+            ResizeBuffer(tga.data.bandData, bandSize);
+        }
+        char* bandData = tga.data.bandData.data();
+
+        StageTimer readTimer(StageSeconds(stats.payloadReadSeconds));
+
+        // keep the overlapping rows, read the rest
+        int keptRows = 0;
+        if (firstSourceRow < windowEnd && firstSourceRow >= windowFirst) {
+            keptRows = windowEnd - firstSourceRow;
+            memmove(bandData, bandData + static_cast<size_t>(firstSourceRow - windowFirst) * rowSize,
+                static_cast<size_t>(keptRows) * rowSize);
+        }
+
+        char* readData = bandData + static_cast<size_t>(keptRows) * rowSize;
+        const int readFirst = firstSourceRow + keptRows;
+        const int readRows = lastSourceRow + 1 - readFirst;
+
+        if (runLengthEncoded) {
+            // compressed rows cannot be seeked to, rows no band needs are decoded and dropped
+            for (; nextRow < readFirst; nextRow++) {
+                if (!decoder.Decode(readData, static_cast<size_t>(width)))
+                    return FILE_ERR_BAD_FORMAT;
+            }
+            if (!decoder.Decode(readData, static_cast<size_t>(readRows) * static_cast<size_t>(width)))
+                return FILE_ERR_BAD_FORMAT;
+        }
+        else {
+            if (readFirst != nextRow) {
+                imageFile.seekg(pixelOffset + static_cast<std::streamoff>(readFirst) * static_cast<std::streamoff>(rowSize));
+            }
+            imageFile.read(readData, static_cast<size_t>(readRows) * rowSize);
+            stats.bytesRead += static_cast<size_t>(imageFile.gcount());
+            if (!imageFile)
+                return FILE_ERR_BAD_FORMAT;
+        }
+        nextRow = readFirst + readRows;
+        readTimer.Stop();
+
+        windowFirst = firstSourceRow;
+        windowEnd = lastSourceRow + 1;
+
+        ResizePixels(bandData, firstSourceRow, tga.header.width, tga.header.height, rowSize, tga.data.resizedBandData.data(),
+            newWidth, newHeight, newRowSize, firstRow, endRow, PixelFormat(tga.header), interpolationMethod);
+
+        WriteRows(outputFile, tga.data.resizedBandData.data(), endRow - firstRow, newWidth, bitDepth);
+    }
+
+    // compressed input only, nothing was decoded from uncompressed files
+    stats.bytesRead += decoder.GetBytesRead();
+
+    StageTimer writeTimer(StageSeconds(stats.writeSeconds));
+    outputFile.close();
+
+    return (!outputFile.fail() && output.Commit()) ? FILE_OK : FILE_ERR_OPEN;
+}
+
+void TGAProcessing::BuildMipChain()
+{
+    StageTimer interpolationTimer(StageSeconds(stats.interpolationSeconds));
+
+    const size_t bitDepth = BytesPerPixel(tga.header);
+    const t_mipkernel mipKernel = SelectMipKernel(PixelFormat(tga.header), linearLight);
+    std::vector<t_miplevel>& levels = tga.data.mipLevels;
+
+    // level sizes and offsets, a side of 1 pixel stays 1
+    const size_t levelCapacity = levels.capacity();
+    levels.clear();
+    size_t mipSize = 0;
+    int width = tga.header.width;
+    int height = tga.header.height;
+    while (width > 1 || height > 1) {
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+
+        t_miplevel level = { width, height, mipSize };
+        levels.push_back(level);
+        mipSize += static_cast<size_t>(width) * static_cast<size_t>(height) * bitDepth;
+    }
+    if (levels.capacity() != levelCapacity) {
+        TrackAllocation();
+    }
+    if (levels.empty())
+        return;
+
+    // capacity is kept from the previous chain
+    ResizeBuffer(tga.data.mipData, mipSize);
+    char* mipData = tga.data.mipData.data();
+
+    auto levelPixels = [&](size_t level) -> const char* {
+        return (level == 0) ? tga.data.originalPixels : mipData + levels[level - 1].offset;
+    };
+    auto levelWidth = [&](size_t level) { return (level == 0) ? static_cast<int>(tga.header.width) : levels[level - 1].width; };
+    auto levelHeight = [&](size_t level) { return (level == 0) ? static_cast<int>(tga.header.height) : levels[level - 1].height; };
+
+    auto computeRows = [&](size_t level, int firstRow, int endRow) {
+        const t_miplevel& mipLevel = levels[level - 1];
+        const size_t newRowSize = static_cast<size_t>(mipLevel.width) * bitDepth;
+        mipKernel(levelPixels(level - 1), levelWidth(level - 1), levelHeight(level - 1),
+            mipData + mipLevel.offset + static_cast<size_t>(firstRow) * newRowSize, firstRow, endRow);
+    };
+
+    // Bands of 2^MIP_CASCADE_LEVELS level 1 rows: level n + 1 of a band is made of the level n rows of the same
+    // band, so each band runs down MIP_CASCADE_LEVELS + 1 levels on its own
+    const int bandRows = 1 << MIP_CASCADE_LEVELS;
+    const size_t cascadeLevels = (levels.size() < MIP_CASCADE_LEVELS + 1) ? levels.size() : MIP_CASCADE_LEVELS + 1;
+    const int bandCount = (levels[0].height + bandRows - 1) / bandRows;
+
+    threadPool->ParallelFor(bandCount, 1, [&](int bandBegin, int bandEnd) {
+        for (int band = bandBegin; band < bandEnd; band++) {
+            for (size_t level = 1; level <= cascadeLevels; level++) {
+                const int firstRow = (band * bandRows) >> (level - 1);
+                int endRow = ((band + 1) * bandRows) >> (level - 1);
+                if (endRow > levels[level - 1].height) {
+                    endRow = levels[level - 1].height;
+                }
+                if (firstRow >= endRow)
+                    break;
+
+                computeRows(level, firstRow, endRow);
+            }
+        }
+    });
+
+    // the remaining levels are 2^MIP_CASCADE_LEVELS times smaller and fit in cache
+    for (size_t level = cascadeLevels + 1; level <= levels.size(); level++) {
+        computeRows(level, 0, levels[level - 1].height);
+    }
+}
+
+fileStatus TGAProcessing::SaveMipChain(const std::string& outputFileName, bool packed)
+{
+    const size_t bitDepth = BytesPerPixel(tga.header);
+    const std::vector<t_miplevel>& levels = tga.data.mipLevels;
+
+    if (!packed) {
+        for (size_t level = 0; level < levels.size(); level++) {
+            const std::string levelFileName = MipFileName(outputFileName, level + 1);
+            OutputFile output(levelFileName, tga.data.outputTemporaryName);
+            std::fstream file;
+            OpenFile(file, output.GetTemporaryName(), std::ios::out | std::ios::binary, tga.data.outputFileBuffer);
+            if (!file.is_open())
+                return FILE_ERR_OPEN;
+
+            WriteHeader(file, levels[level].width, levels[level].height);
+            WriteRows(file, tga.data.mipData.data() + levels[level].offset, levels[level].height, levels[level].width, bitDepth);
+            file.close();
+            if (file.fail() || !output.Commit())
+                return FILE_ERR_OPEN;
+        }
+        return FILE_OK;
+    }
+
+    OutputFile output(outputFileName, tga.data.outputTemporaryName);
+    std::fstream file;
+    OpenFile(file, output.GetTemporaryName(), std::ios::out | std::ios::binary, tga.data.outputFileBuffer);
+    if (!file.is_open())
+        return FILE_ERR_OPEN;
+
+    // one image as wide as level 1, the smaller levels are padded with zeros on the right
+    const int packedWidth = levels.empty() ? 0 : levels[0].width;
+    int packedHeight = 0;
+    for (const t_miplevel& level : levels) {
+        packedHeight += level.height;
+    }
+
+    WriteHeader(file, packedWidth, packedHeight);
+
+    const size_t packedRowSize = static_cast<size_t>(packedWidth) * bitDepth;
+    std::vector<char>& packedRows = tga.data.resizedBandData;
+    for (const t_miplevel& level : levels) {
+        const size_t rowSize = static_cast<size_t>(level.width) * bitDepth;
+        ResizeBuffer(packedRows, static_cast<size_t>(level.height) * packedRowSize);
+        std::fill(packedRows.begin(), packedRows.end(), static_cast<char>(0));
+        for (int row = 0; row < level.height; row++) {
+            memcpy(packedRows.data() + static_cast<size_t>(row) * packedRowSize,
+                tga.data.mipData.data() + level.offset + static_cast<size_t>(row) * rowSize, rowSize);
+        }
+        WriteRows(file, packedRows.data(), level.height, packedWidth, bitDepth);
+    }
+
+    file.close();
+    return (!file.fail() && output.Commit()) ? FILE_OK : FILE_ERR_OPEN;
+}
+
+size_t TGAProcessing::GetMipLevelCount() const
+{
+    return tga.data.mipLevels.size();
+}
+
+std::string TGAProcessing::MipFileName(const std::string& outputFileName, size_t level)
+{
+    // the level number goes before the extension of the file name, not of a directory
+    const size_t separator = outputFileName.find_last_of("/\\");
+    size_t extension = outputFileName.rfind('.');
+    if (extension == std::string::npos || (separator != std::string::npos && extension < separator)) {
+        extension = outputFileName.size();
+    }
+    return outputFileName.substr(0, extension) + "_" + std::to_string(level) + outputFileName.substr(extension);
 }
 
 void TGAProcessing::WriteImage(std::fstream& imageFile, t_tgaheader& tgaHeader, t_tgadata& tgaData)
 {
-    // pixel area * BGR values
-    const int newHeight = tgaHeader.height / SCALING_FACTOR;
-    const int newWidth = tgaHeader.width / SCALING_FACTOR;
-    const int newArea = newHeight * newWidth;
-    const size_t bitDepth = (tgaHeader.pixelDepth / IMAGEBIT_SIZE);
-    const size_t pixelAreaBitSize = newArea * bitDepth ;
+    const int newHeight = tgaData.resizedHeight;
+    const int newWidth = tgaData.resizedWidth;
+    const size_t bitDepth = BytesPerPixel(tgaHeader);
 
     // Write Header
-    imageFile.write(&tgaHeader.idLength, sizeof(tgaHeader.idLength));
-    imageFile.write(&tgaHeader.colourMapType, sizeof(tgaHeader.colourMapType));
-    imageFile.write(&tgaHeader.imageType, sizeof(tgaHeader.imageType));
-    imageFile.write((char*)(&tgaHeader.colourMapOrigin), sizeof(tgaHeader.colourMapOrigin));
-    imageFile.write((char*)(&tgaHeader.colourMapLength), sizeof(tgaHeader.colourMapLength));
-    imageFile.write(&tgaHeader.colourMapDepth, sizeof(tgaHeader.colourMapDepth));
-    imageFile.write((char*)(&tgaHeader.x_origin), sizeof(tgaHeader.x_origin));
-    imageFile.write((char*)(&tgaHeader.y_origin), sizeof(tgaHeader.y_origin));
-    imageFile.write((char*)(&newWidth), sizeof(tgaHeader.width));
-    imageFile.write((char*)(&newHeight), sizeof(tgaHeader.height));
-    imageFile.write(&tgaHeader.pixelDepth, sizeof(tgaHeader.pixelDepth));
-    imageFile.write(&tgaHeader.imageDescriptor, sizeof(tgaHeader.pixelDepth));
+    WriteHeader(imageFile, newWidth, newHeight);
 
     // Write Pixel BGR data
-    imageFile.write(tgaData.resizedData.get(), pixelAreaBitSize);
+    WriteRows(imageFile, tgaData.resizedData.data(), newHeight, newWidth, bitDepth);
+}
+
+void TGAProcessing::WriteHeader(std::fstream& imageFile, int newWidth, int newHeight)
+{
+    StageTimer writeTimer(StageSeconds(stats.writeSeconds));
+
+    char headerData[TGA_HEADER_SIZE];
+    SerializeHeader(tga.header, newWidth, newHeight, rleOutput, headerData);
+    imageFile.write(headerData, TGA_HEADER_SIZE);
+    stats.bytesWritten += TGA_HEADER_SIZE;
+}
+
+void TGAProcessing::WriteRows(std::fstream& imageFile, const char* rows, int rowCount, int newWidth, size_t bitDepth)
+{
+    StageTimer writeTimer(StageSeconds(stats.writeSeconds));
+
+    const size_t newRowSize = static_cast<size_t>(newWidth) * bitDepth;
+
+    if (!rleOutput) {
+        imageFile.write(rows, static_cast<size_t>(rowCount) * newRowSize);
+        stats.bytesWritten += static_cast<size_t>(rowCount) * newRowSize;
+        return;
+    }
+
+    // each row is encoded on its own, the buffer is kept for the next call
+    std::vector<char>& encodedData = tga.data.encodedData;
+    const size_t encodedCapacity = encodedData.capacity();
+    encodedData.clear();
+    encodedData.reserve(static_cast<size_t>(rowCount) * rle_max_row_size(newWidth, bitDepth));
+    if (encodedData.capacity() != encodedCapacity) {
+        TrackAllocation();
+    }
+
+    for (int row = 0; row < rowCount; row++) {
+        rle_encode_row(rows + static_cast<size_t>(row) * newRowSize, newWidth, bitDepth, encodedData);
+    }
+    imageFile.write(encodedData.data(), encodedData.size());
+    stats.bytesWritten += encodedData.size();
 }
 
 
@@ -163,3 +1153,165 @@ size_t TGAProcessing::GetDepth()
 {
     return tga.header.pixelDepth;
 }
+
+void TGAProcessing::SetMemoryMapping(bool enabled)
+{
+    useMemoryMapping = enabled;
+}
+
+void TGAProcessing::SetPrefetch(bool enabled)
+{
+    prefetch = enabled;
+}
+
+void TGAProcessing::SetParallelRead(bool enabled)
+{
+    parallelRead = enabled;
+}
+
+void TGAProcessing::SetDirectIo(bool enabled)
+{
+    directIo = enabled;
+}
+
+void TGAProcessing::ResizedSize(int width, int height, float scaleFactor, int& newWidth, int& newHeight)
+{
+    newWidth = static_cast<int>(static_cast<float>(width) / scaleFactor);
+    newHeight = static_cast<int>(static_cast<float>(height) / scaleFactor);
+    if (newWidth < 1) {
+        newWidth = 1;
+    }
+    if (newHeight < 1) {
+        newHeight = 1;
+    }
+}
+
+void TGAProcessing::ReserveBuffers(int width, int height, size_t bytesPerPixel)
+{
+    // resize() writes the bytes it adds, which faults their pages in
+    const size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * bytesPerPixel;
+    if (tga.data.originalData.size() < size) {
+        ResizeBuffer(tga.data.originalData, size);
+    }
+    if (tga.data.resizedData.size() < size) {
+        ResizeBuffer(tga.data.resizedData, size);
+    }
+    if (tga.data.inputFileBuffer.size() < FILE_BUFFER_SIZE) {
+        ResizeBuffer(tga.data.inputFileBuffer, FILE_BUFFER_SIZE);
+    }
+    if (tga.data.outputFileBuffer.size() < FILE_BUFFER_SIZE) {
+        ResizeBuffer(tga.data.outputFileBuffer, FILE_BUFFER_SIZE);
+    }
+}
+
+void TGAProcessing::SetRleOutput(bool enabled)
+{
+    rleOutput = enabled;
+}
+
+void TGAProcessing::SetLinearLight(bool enabled)
+{
+    linearLight = enabled;
+}
+
+void TGAProcessing::SetOutputCache(std::shared_ptr<OutputCache> cache)
+{
+    outputCache = cache;
+    cacheKeyValid = false;
+    resizePending = false;
+}
+
+void TGAProcessing::SetThreadCount(size_t threadCount)
+{
+    threadPool = std::make_shared<ThreadPool>(threadCount);
+}
+
+size_t TGAProcessing::GetThreadCount() const
+{
+    return threadPool->GetThreadCount();
+}
+
+void TGAProcessing::SetStatsEnabled(bool enabled)
+{
+    collectStats = enabled;
+}
+
+const t_tgastats& TGAProcessing::GetStats() const
+{
+    return stats;
+}
+
+void TGAProcessing::ResetStats()
+{
+    stats = t_tgastats();
+    if (collectStats) {
+        // buffers kept from the previous image count towards the peak of this one
+        stats.peakBufferBytes = BufferBytes();
+    }
+}
+
+/**
+* Output cache key of the loaded image resized to newWidth x newHeight
+* Everything the output depends on is hashed: its header, the resize and the original pixels, which are read
+* in place from the mapping or originalData
+*/
+uint64_t TGAProcessing::CacheKey(int newWidth, int newHeight, resizeMethod interpolationMethod)
+{
+    StageTimer hashTimer(StageSeconds(stats.hashSeconds));
+
+    char headerData[TGA_HEADER_SIZE];
+    SerializeHeader(tga.header, tga.header.width, tga.header.height, rleOutput, headerData);
+    const int32_t parameters[] = { OUTPUT_CACHE_VERSION, newWidth, newHeight, static_cast<int32_t>(interpolationMethod),
+                                   linearLight ? 1 : 0 };
+    const size_t pixelBytes = static_cast<size_t>(tga.header.width) * static_cast<size_t>(tga.header.height) *
+                              BytesPerPixel(tga.header);
+
+    t_xxh64state state;
+    xxh64_reset(state, 0);
+    xxh64_update(state, headerData, sizeof(headerData));
+    xxh64_update(state, parameters, sizeof(parameters));
+    xxh64_update(state, tga.data.originalPixels, pixelBytes);
+    return xxh64_digest(state);
+}
+
+// Puts the cached output of cacheKey at outputFileName, false on a miss
+bool TGAProcessing::FetchCachedOutput(const std::string& outputFileName)
+{
+    StageTimer writeTimer(StageSeconds(stats.writeSeconds));
+
+    if (outputCache->Fetch(cacheKey, outputFileName)) {
+        stats.cacheHits++;
+        return true;
+    }
+    return false;
+}
+
+void TGAProcessing::StoreCachedOutput(const std::string& outputFileName)
+{
+    StageTimer writeTimer(StageSeconds(stats.writeSeconds));
+    outputCache->Store(cacheKey, outputFileName);
+}
+
+double* TGAProcessing::StageSeconds(double& stageSeconds)
+{
+    return collectStats ? &stageSeconds : nullptr;
+}
+
+void TGAProcessing::TrackAllocation()
+{
+    if (!collectStats)
+        return;
+
+    stats.allocations++;
+    const size_t bufferBytes = BufferBytes();
+    if (bufferBytes > stats.peakBufferBytes) {
+        stats.peakBufferBytes = bufferBytes;
+    }
+}
+
+size_t TGAProcessing::BufferBytes() const
+{
+    return tga.data.originalData.capacity() + tga.data.resizedData.capacity() + tga.data.bandData.capacity() +
+           tga.data.resizedBandData.capacity() + tga.data.encodedData.capacity() + tga.data.inputFileBuffer.capacity() +
+           tga.data.outputFileBuffer.capacity() + tga.data.mipData.capacity() + tga.data.mipLevels.capacity() * sizeof(t_miplevel);
+}
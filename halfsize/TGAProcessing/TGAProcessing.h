@@ -1,15 +1,47 @@
 #ifndef TGAPROCESSING_H
 #define TGAPROCESSING_H
 
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "../Common/Utilities.h"
+#include "../Common/BoxFilter.h"
+#include "../Common/ChunkedFile.h"
+#include "../Common/Hash.h"
+#include "../Common/LinearLight.h"
+#include "../Common/MappedFile.h"
+#include "../Common/OutputCache.h"
+#include "../Common/OutputFile.h"
+#include "../Common/Resampler.h"
+#include "../Common/RleCodec.h"
+#include "../Common/Stats.h"
+#include "../ThreadPool/ThreadPool.h"
 
 #define DEBUG_FLAG          1
 
+#define TGA_HEADER_SIZE     18      // bytes of the header in the file
+#define STREAM_BAND_ROWS    64      // output rows produced per band in streaming mode
+#define FILE_BUFFER_SIZE    65536   // bytes of the std::fstream buffers kept in t_tgadata
+
+#define TGA_TYPE_TRUECOLOR      2   // uncompressed BGR/BGRA
+#define TGA_TYPE_GREY           3   // uncompressed greyscale
+#define TGA_TYPE_RLE_TRUECOLOR  10  // run-length encoded BGR/BGRA
+#define TGA_TYPE_RLE_GREY       11  // run-length encoded greyscale
+
+#define TGA_DESCRIPTOR_RIGHT_TO_LEFT    0x10    // imageDescriptor bit 4: the first pixel of a row is the rightmost one
+#define TGA_DESCRIPTOR_TOP_DOWN         0x20    // imageDescriptor bit 5: the first row is the top one, else the bottom one
+
+#define MIN_ROWS_PER_BAND   16      // smallest band of output rows handed to one thread
+#define BANDS_PER_THREAD    4       // more bands than threads to even out the load
+
+#define MIP_CASCADE_LEVELS  5       // mip levels a band computes right after the rows they are made from
+
+#define OUTPUT_CACHE_VERSION    2   // part of every output cache key, bumped when a kernel changes its output
+
 
 
 /**
@@ -20,7 +52,7 @@ typedef struct
 {
     char  idLength;             // Image ID length of the image information field (unit byte)
     char  colourMapType;        // 0: No color table 1: With color table
-    char  imageType;            // 2  -  Uncompressed, RGB images.
+    char  imageType;            // 2/3 - Uncompressed RGB/greyscale images, 10/11 - Run-length encoded RGB/greyscale images
 
     short int colourMapOrigin;  // The position of the first colormap entry
     short int colourMapLength;  // Number of color table entries 
@@ -28,32 +60,76 @@ typedef struct
      
     short int x_origin;         // Horizontal coordinates of the lower left corner of the image, low in the front and high in the back
     short int y_origin;         // Vertical coordinate of the lower left corner of the image, low in front and high in back
-    short width;                // Image width (2 bytes): width in pixels
-    short height;               // Image height (2 bytes): height in pixels
+    unsigned short width;       // Image width (2 bytes): width in pixels, up to 65535
+    unsigned short height;      // Image height (2 bytes): height in pixels, up to 65535
     char pixelDepth;            // Image color depth 8, 16, 24, 32 (bit)
     char imageDescriptor;       // Image descriptor (1 byte): bits 3-0 give the alpha channel depth, bits 5-4 give pixel ordering
 } t_tgaheader;
 
+/**
+One level of a mip chain
+*/
+typedef struct
+{
+    int     width;
+    int     height;
+    size_t  offset;         // first byte of the level in t_tgadata::mipData
+} t_miplevel;
+
+/**
+Rectangle of an image, as displayed: x to the right and y down from the top-left pixel
+*/
+typedef struct
+{
+    int     x;
+    int     y;
+    int     width;
+    int     height;
+} t_region;
+
 /**
 TGA Data
-Channel order is BGRA
-Each channel stores 8 bytes 
+Channel order is BGRA, pixels are kept interleaved in the pixelFormat of the header
+(8 bit grey, 16 bit A1R5G5B5, 24 bit BGR or 32 bit BGRA)
+The buffers only grow: an image of the same or a smaller size reuses them without allocating
 */
 typedef struct
 {
-    std::unique_ptr<char[]> originalData;
-    std::unique_ptr<char[]> resizedData;
-
-    // De-interleaved RBG data
-    std::vector<char> redChn;
-    std::vector<char> greenChn;
-    std::vector<char> blueChn;
-    std::vector<char> alphaChn;
-    
-    std::vector<char> redChnResized;
-    std::vector<char> greenChnResized;
-    std::vector<char> blueChnResized;
-    std::vector<char> alphaChnResized;
+    // Aligned for the SIMD kernels and for direct reads into it
+    std::vector<char, aligned_allocator<char, DIRECT_IO_ALIGNMENT>> originalData;
+    std::vector<char> resizedData;
+
+    // Size of resizedData
+    int resizedWidth = 0;
+    int resizedHeight = 0;
+
+    // Memory-mapped input file, the original pixels are read straight from the mapping
+    // Kept open until the next image is loaded
+    std::unique_ptr<MappedFile> inputMapping;
+
+    // Input file of the parallel reads, closed once the pixels are read
+    std::unique_ptr<ChunkedFile> inputFile;
+
+    // Original pixels, either originalData or the pixel payload of inputMapping
+    const char* originalPixels = nullptr;
+
+    // Streaming mode: source rows of the current band and the output rows computed from them
+    std::vector<char> bandData;
+    std::vector<char> resizedBandData;
+
+    // Run-length encoded output rows waiting to be written
+    std::vector<char> encodedData;
+
+    // std::fstream buffers of the input and output files
+    std::vector<char> inputFileBuffer;
+    std::vector<char> outputFileBuffer;
+
+    // Temporary name of the output being written, see OutputFile
+    std::string outputTemporaryName;
+
+    // Mip chain: every level after the original one, packed one after another
+    std::vector<char> mipData;
+    std::vector<t_miplevel> mipLevels;
 
 } t_tgadata;
 
@@ -68,22 +144,267 @@ typedef struct {
 class TGAProcessing
 {
 public:
+    TGAProcessing();
+    explicit TGAProcessing(std::shared_ptr<ThreadPool> sharedThreadPool);
 
     fileStatus LoadImage(const std::string& inputFileName);
     fileStatus SaveImage(const std::string& outputFileName);
 
     void ResizeImage(float scaleFactor, resizeMethod interpolationMethod);
 
+    /**
+    * Resizes the loaded image to a given size
+    *
+    * @param newWidth            - width of the resized image, at least 1
+    * @param newHeight           - height of the resized image, at least 1
+    * @param interpolationMethod - resizing method, the box filter falls back to bilinear unless the size is halved
+    */
+    void ResizeImage(int newWidth, int newHeight, resizeMethod interpolationMethod);
+
+    /**
+    * Loads a region of an image file, which then stands for the loaded image: GetWidth() and GetHeight() give
+    * the region size and ResizeImage(), SaveImage() or BuildMipChain() work on the region alone
+    * Only the bytes of the region are read, from the mapping or with one seek and read per row, and only the
+    * region is held in memory. Compressed files are decoded up to the last row of the region and no further.
+    * The origin bits of imageDescriptor are honoured: the rows of bottom-up files and the columns of
+    * right-to-left files are found from the other end, and the region keeps the order of the file.
+    *
+    * @param inputFileName - path of the original image
+    * @param region        - region to load, as displayed
+    */
+    fileStatus LoadRegion(const std::string& inputFileName, const t_region& region);
+
+    /**
+    * Loads a region of an image file, resizes it to newWidth x newHeight and saves it
+    *
+    * @param inputFileName       - path of the original image
+    * @param outputFileName      - path of the resized region
+    * @param region              - region of the original image, as displayed
+    * @param newWidth            - width of the resized region
+    * @param newHeight           - height of the resized region
+    * @param interpolationMethod - resizing method
+    */
+    fileStatus ResizeRegion(const std::string& inputFileName, const std::string& outputFileName, const t_region& region,
+        int newWidth, int newHeight, resizeMethod interpolationMethod);
+
+    /**
+    * Resizes caller-owned pixels into caller-owned pixels, without files and without copying the image
+    * Both buffers may be padded or be a sub-rectangle of a larger image, see t_imagebuffer, and must not overlap.
+    * Runs on the thread pool like ResizeImage, the loaded image and the output cache are left alone.
+    *
+    * @param source              - original pixels, only read
+    * @param target              - resized pixels, its width and height give the new size
+    * @param interpolationMethod - resizing method, the box filter falls back to bilinear unless the size is halved
+    * @return FILE_ERR_BAD_BUFFER for a missing or empty buffer or a stride shorter than a row,
+    *         FILE_ERR_UNSUPPORTED if the pixel formats differ
+    */
+    fileStatus ResizeImageBuffer(const t_imagebuffer& source, const t_imagebuffer& target, resizeMethod interpolationMethod);
+
+    /**
+    * Resizes the loaded image and saves it in one step
+    * With memory mapping the output file is mapped and the resize kernels write straight into it
+    * Like every output it is written under a temporary name and renamed over outputFileName, which may be the
+    * loaded image file, see OutputFile
+    *
+    * @param outputFileName      - path of the resized image
+    * @param scaleFactor         - resizing scale factor ( > 1 shrink, < 1 enlarge)
+    * @param interpolationMethod - resizing method
+    */
+    fileStatus ResizeImageToFile(const std::string& outputFileName, float scaleFactor, resizeMethod interpolationMethod);
+
+    /**
+    * Resizes an image file in horizontal bands with bounded memory
+    * Reads the source rows of bandRows output rows, resizes and writes them, and reuses the buffers for the
+    * next band. Memory is O(width * bandRows) whatever the image height, nothing is kept loaded afterwards.
+    *
+    * @param inputFileName       - path of the original image
+    * @param outputFileName      - path of the resized image
+    * @param scaleFactor         - resizing scale factor ( > 1 shrink, < 1 enlarge)
+    * @param interpolationMethod - resizing method
+    * @param bandRows            - output rows per band
+    */
+    fileStatus ResizeImageStreaming(const std::string& inputFileName, const std::string& outputFileName,
+        float scaleFactor, resizeMethod interpolationMethod, int bandRows = STREAM_BAND_ROWS);
+
+    /**
+    * Builds the mip chain of the loaded image, each level the 2x2 box filtered previous one, down to 1x1
+    * The original is read once: every band of level 1 rows is followed straight away by the rows of the
+    * next MIP_CASCADE_LEVELS levels made from it, while they are still in cache. A side of 1 pixel stays 1.
+    * The buffers are kept and reused by the next call.
+    */
+    void BuildMipChain();
+
+    /**
+    * Writes the levels made by BuildMipChain, the original image (level 0) is not written
+    *
+    * @param outputFileName - path of the levels, "mip.tga" gives "mip_1.tga", "mip_2.tga"... or the packed file
+    * @param packed         - true: all levels in one image, stacked top to bottom and left-aligned
+    */
+    fileStatus SaveMipChain(const std::string& outputFileName, bool packed);
+
+    size_t GetMipLevelCount() const;
+
+    /**
+    * Enables memory-mapped loading and saving, on by default
+    * Without it images are read and written through std::fstream
+    */
+    void SetMemoryMapping(bool enabled);
+
+    /**
+    * Makes LoadImage read the mapped pixels before it returns, off by default
+    * Without it the pages are read when the resize kernels first touch them
+    */
+    void SetPrefetch(bool enabled);
+
+    /**
+    * Makes LoadImage read uncompressed pixels with positional reads on the thread pool, off by default
+    * The header is read with one 18 byte read, then the pixels in CHUNKED_READ_SIZE chunks on several threads
+    * straight into the aligned originalData, instead of one sequential stream. Takes precedence over memory
+    * mapping, compressed images are still decoded from the mapping or the stream.
+    */
+    void SetParallelRead(bool enabled);
+
+    /**
+    * Makes the parallel reads bypass the page cache (O_DIRECT, FILE_FLAG_NO_BUFFERING), off by default
+    * For images read once from fast storage, the page cache only costs a copy then. The file is read from its
+    * first byte in whole DIRECT_IO_ALIGNMENT blocks, the pixels start after the header in originalData.
+    * Filesystems that refuse direct I/O are read through the page cache.
+    */
+    void SetDirectIo(bool enabled);
+
+    /**
+    * Enables run-length encoded output (image type 10/11), off by default
+    * Encoded images are written through std::fstream, their size is only known once encoded
+    */
+    void SetRleOutput(bool enabled);
+
+    /**
+    * Filters in linear light with premultiplied alpha, off by default
+    * The sRGB bytes are decoded to 16 bit linear light through a table, 32 bit pixels are premultiplied by
+    * their alpha, and the filtered pixels are unpremultiplied and encoded back through a second table.
+    * Averages then keep the brightness of the original and transparent pixels do not bleed their colour into
+    * the edges of sprites. Off for data that is not sRGB colour, e.g. normal or height maps.
+    * Applies to every method but nearest neighbour, which does not blend, and to mip chains. 16 bit pixels
+    * are always filtered as stored.
+    */
+    void SetLinearLight(bool enabled);
+
+    /**
+    * Sets the output cache of ResizeImage/SaveImage and ResizeImageToFile, none by default
+    * The key of an image hashes the original pixels with the header and the resize parameters. On a hit
+    * nothing is resized and the cached image is linked to the output, on a miss the output written is added.
+    * Streamed images and mip chains are not cached.
+    *
+    * @param cache - cache to use, it may be shared with other instances, nullptr = none
+    */
+    void SetOutputCache(std::shared_ptr<OutputCache> cache);
+
+    /**
+    * Enables the per-image stats, off by default
+    * LoadImage and ResizeImageStreaming start the stats of a new image, the calls after them add to it
+    */
+    void SetStatsEnabled(bool enabled);
+    const t_tgastats& GetStats() const;
+    void ResetStats();
+
+    /**
+    * Grows the pixel and file buffers for images up to width x height and writes them once, so that their
+    * pages are faulted in now and not by the first image, e.g. in a server before its first job
+    *
+    * @param bytesPerPixel - largest pixel size of the images, e.g. PIXELDEPTH_32BIT
+    */
+    void ReserveBuffers(int width, int height, size_t bytesPerPixel);
+
     size_t GetWidth();
     size_t GetHeight();
     size_t GetDepth();
 
+    /**
+    * Size of an image of this width and height once resized, at least 1x1
+    *
+    * @param scaleFactor - resizing scale factor ( > 1 shrink, < 1 enlarge)
+    */
+    static void ResizedSize(int width, int height, float scaleFactor, int& newWidth, int& newHeight);
+
+    /**
+    * Replaces the thread pool used by ResizeImage with a new one of threadCount threads
+    * The output does not depend on the number of threads
+    *
+    * @param threadCount - number of threads, 0 = all cores
+    */
+    void SetThreadCount(size_t threadCount);
+    size_t GetThreadCount() const;
+
 private:
     t_tga           tga;
     fileStatus      imageStatus;
 
+    std::shared_ptr<ThreadPool> threadPool;
+    bool            useMemoryMapping;
+    bool            prefetch;
+    bool            parallelRead;
+    bool            directIo;
+    bool            rleOutput;
+    bool            linearLight;
+
+    bool            collectStats;
+    t_tgastats      stats;
+
+    // taps of the last separable filter, reused while the sizes do not change
+    std::unique_ptr<Resampler> resampler;
+
+    // run-length decoder, its read buffer is reused by every compressed image
+    RleDecoder      rleDecoder;
+
+    // output cache and the key of the image resized last
+    std::shared_ptr<OutputCache> outputCache;
+    uint64_t        cacheKey;
+    bool            cacheKeyValid;
+    bool            resizePending;      // ResizeImage found the image cached and left the resize to SaveImage
+    resizeMethod    pendingMethod;      // method of that resize, done if the entry is gone by then
+
+    void OpenFile(std::fstream& file, const std::string& fileName, std::ios::openmode mode, std::vector<char>& buffer);
+    fileStatus ReadHeader(std::fstream& imageFile, t_tgaheader& tgaHeader);
     fileStatus ReadImage(std::fstream& imageFile, t_tgaheader& tgaHeader, t_tgadata& tgaData);
+    fileStatus MapImage(const std::string& inputFileName, t_tgaheader& tgaHeader, t_tgadata& tgaData);
+    fileStatus ReadImageParallel(const std::string& inputFileName, t_tgaheader& tgaHeader, t_tgadata& tgaData);
     void WriteImage(std::fstream& imageFile, t_tgaheader& tgaHeader, t_tgadata& tgaData);
+    void WriteHeader(std::fstream& imageFile, int newWidth, int newHeight);
+    void WriteRows(std::fstream& imageFile, const char* rows, int rowCount, int newWidth, size_t bitDepth);
+
+    void ResizeToSize(int newWidth, int newHeight, resizeMethod interpolationMethod);
+    void ResizeLoadedImage(resizeMethod interpolationMethod);
+    void ResizePixels(const char* originalPixels, int firstSourceRow, int width, int height, size_t rowStride,
+        char* resizedPixels, int newWidth, int newHeight, size_t newRowStride, int firstRow, int endRow, pixelFormat format,
+        resizeMethod interpolationMethod);
+
+    const Resampler& GetResampler(resizeMethod interpolationMethod, int width, int height, int newWidth, int newHeight,
+        pixelFormat format);
+    void SourceRows(resizeMethod interpolationMethod, int firstRow, int endRow, int newWidth, int newHeight,
+        int& firstSourceRow, int& lastSourceRow);
+
+    uint64_t CacheKey(int newWidth, int newHeight, resizeMethod interpolationMethod);
+    bool FetchCachedOutput(const std::string& outputFileName);
+    void StoreCachedOutput(const std::string& outputFileName);
+
+    double* StageSeconds(double& stageSeconds);
+    void TrackAllocation();
+    size_t BufferBytes() const;
+    template <typename T, typename Allocator>
+    void ResizeBuffer(std::vector<T, Allocator>& buffer, size_t size);
+
+    // BOX_FILTER_2X becomes BILINEAR_INTERPOL unless the new size is exactly half of the size
+    static resizeMethod SelectMethod(int width, int height, int newWidth, int newHeight, resizeMethod interpolationMethod);
+
+    static fileStatus CheckHeader(const t_tgaheader& tgaHeader);
+    static pixelFormat PixelFormat(const t_tgaheader& tgaHeader);
+    static size_t BytesPerPixel(const t_tgaheader& tgaHeader);
+    static t_resizekernel SelectKernel(resizeMethod interpolationMethod, pixelFormat format, bool linearLight);
+    static t_mipkernel SelectMipKernel(pixelFormat format, bool linearLight);
+    static void ParseHeader(const char* headerData, t_tgaheader& tgaHeader);
+    static void SerializeHeader(const t_tgaheader& tgaHeader, int width, int height, bool runLengthEncoded, char* headerData);
+    static bool IsRunLengthEncoded(const t_tgaheader& tgaHeader);
+    static std::string MipFileName(const std::string& outputFileName, size_t level);
 };
 
 
@@ -0,0 +1,1150 @@
+/**
+Golden image and performance regression tests
+
+Every resizeMethod on every pixel format is checked against a plain double precision reference written from
+the definitions of the filters, on deterministic synthetic images and on a real image (--image):
+- nearest neighbour and the 2x box filter bit-exactly
+- bilinear, area, bicubic and Lanczos3, and all of them in linear light, by a minimum PSNR per method, as
+  the kernels round their fixed-point weights and the separable filters their horizontal pass
+- bilinear, halving an even sized image, against nearest neighbour: most pixels must differ
+The file paths (mapping, std::fstream, parallel reads, ResizeImageToFile, streaming, regions, run-length
+encoded input and output, several threads) must then give the same bytes as ResizeImageBuffer on the same
+pixels. Images that fail are named with their PSNR or first differing byte, the exit code is 1.
+
+With --perf the kernels are timed instead and compared to a file of ns/pixel baselines, one "name ns" line
+each: a kernel slower than its baseline by more than --margin, also when timed again, fails. Baselines only
+hold for the machine they were recorded on, --write-baseline records them.
+
+Build and run (from the halfsize folder):
+    cmake -S . -B build && cmake --build build && ctest --test-dir build
+    build/halfsize_tests [--filter TEXT] [--image file.tga]
+    build/halfsize_tests --perf Tests/perf_baseline.txt [--margin F] [--filter TEXT]
+    build/halfsize_tests --write-baseline Tests/perf_baseline.txt
+
+    --filter TEXT           only the cases whose name contains TEXT, e.g. lanczos3 or /rle
+    --image FILE            also check the methods on this uncompressed TGA, e.g. half.tga
+    --perf FILE             time the kernels against the baselines of FILE, skips the golden tests
+    --margin F              slowdown allowed by --perf, 0.25 = 25% (default)
+    --write-baseline FILE   time the kernels and write FILE
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../Common/Utilities.h"
+#include "../TGAProcessing/TGAProcessing.h"
+
+#define TEST_WIDTH          301     // odd sizes, so that the last column and row of the box filter are dropped
+#define TEST_HEIGHT         203
+#define TEST_SEED           0x2545F491u
+#define TEST_INPUT_NAME     "halfsize_test_input.tga"
+#define TEST_OUTPUT_NAME    "halfsize_test_output.tga"
+#define TEST_BAND_ROWS      7       // streaming band height, small so that every image crosses several bands
+#define TEST_THREADS        4
+
+#define PERF_WIDTH          1024
+#define PERF_HEIGHT         1024
+#define PERF_REPETITIONS    7       // the best run counts
+#define PERF_MIN_TIME       0.05    // seconds per run
+#define PERF_RETRIES        2       // a kernel over the margin is timed again before it fails, for a busy machine
+#define PERF_DEFAULT_MARGIN 0.25
+
+
+typedef struct
+{
+    std::string filter;
+    std::string imageFileName;
+    std::string perfFileName;
+    std::string baselineOutputName;
+    double      margin;
+} t_testsettings;
+
+/**
+Interleaved pixels in file order, as in the TGA
+*/
+typedef struct
+{
+    int                         width;
+    int                         height;
+    pixelFormat                 format;
+    std::vector<unsigned char>  pixels;
+} t_testimage;
+
+/**
+Reference image, channel values as doubles in the units of the format (0..255, 0..31 or 0..1)
+*/
+typedef struct
+{
+    int                 width;
+    int                 height;
+    int                 channels;
+    std::vector<double> values;
+} t_refimage;
+
+
+static const resizeMethod allMethods[] = { NEAREST_NEIGHBOR, BILINEAR_INTERPOL, BOX_FILTER_2X, AREA_FILTER, BICUBIC_FILTER, LANCZOS3_FILTER };
+static const pixelFormat allFormats[] = { PIXELFORMAT_GREY8, PIXELFORMAT_RGB555, PIXELFORMAT_BGR24, PIXELFORMAT_BGRA32 };
+
+static int failures = 0;
+static int checks = 0;
+
+
+static const char* method_name(resizeMethod interpolationMethod)
+{
+    switch (interpolationMethod) {
+    case NEAREST_NEIGHBOR:  return "nearest";
+    case BILINEAR_INTERPOL: return "bilinear";
+    case BOX_FILTER_2X:     return "box";
+    case AREA_FILTER:       return "area";
+    case BICUBIC_FILTER:    return "bicubic";
+    default:                return "lanczos3";
+    }
+}
+
+static const char* format_name(pixelFormat format)
+{
+    switch (format) {
+    case PIXELFORMAT_GREY8:  return "8bit";
+    case PIXELFORMAT_RGB555: return "16bit";
+    case PIXELFORMAT_BGR24:  return "24bit";
+    default:                 return "32bit";
+    }
+}
+
+static bool selected(const t_testsettings& settings, const std::string& name)
+{
+    return settings.filter.empty() || name.find(settings.filter) != std::string::npos;
+}
+
+static void report(const std::string& name, bool passed, const std::string& detail)
+{
+    checks++;
+    if (!passed) {
+        failures++;
+    }
+    if (!passed || !detail.empty()) {
+        std::cout << (passed ? "[  OK  ] " : "[ FAIL ] ") << name << "  " << detail << std::endl;
+    }
+}
+
+
+// ======================================================
+// Synthetic images
+
+static uint32_t next_random(uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+/**
+* Left third a smooth gradient, middle third 3x3 black and white squares (the filters ring on them),
+* right third noise. Alpha is opaque on top, a gradient below and fully transparent in one block.
+*/
+static t_testimage make_synthetic(pixelFormat format, int width, int height, uint32_t seed)
+{
+    const size_t bytes = pixel_format_bytes(format);
+    t_testimage image = { width, height, format, std::vector<unsigned char>(static_cast<size_t>(width) * height * bytes) };
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned int channel[4];
+            for (int chn = 0; chn < 3; chn++) {
+                if (x < width / 3) {
+                    channel[chn] = static_cast<unsigned int>((x * 3 * 255 / width + y * (chn + 1) * 255 / height / 3) & 0xFF);
+                }
+                else if (x < 2 * width / 3) {
+                    channel[chn] = (((x / 3) + (y / 3) + chn) & 1) ? 255u : 0u;
+                }
+                else {
+                    channel[chn] = next_random(seed) & 0xFF;
+                }
+            }
+            channel[3] = (y < height / 2) ? 255u : static_cast<unsigned int>(x * 255 / width);
+            if (x > width / 4 && x < width / 2 && y > height / 8 && y < height / 4) {
+                channel[3] = 0;
+            }
+
+            unsigned char* pixel = &image.pixels[(static_cast<size_t>(y) * width + x) * bytes];
+            switch (format) {
+            case PIXELFORMAT_GREY8:
+                pixel[0] = static_cast<unsigned char>(channel[0]);
+                break;
+            case PIXELFORMAT_RGB555: {
+                const unsigned int value = (channel[0] >> 3) | ((channel[1] >> 3) << 5) | ((channel[2] >> 3) << 10) |
+                                           ((channel[3] >= 128) ? 0x8000u : 0u);
+                pixel[0] = static_cast<unsigned char>(value & 0xFF);
+                pixel[1] = static_cast<unsigned char>(value >> 8);
+                break;
+            }
+            default:
+                for (size_t byte = 0; byte < bytes; byte++) {
+                    pixel[byte] = static_cast<unsigned char>(channel[byte]);
+                }
+                break;
+            }
+        }
+    }
+    return image;
+}
+
+
+// ======================================================
+// TGA files, written and read here so that the file paths are checked against independent code
+
+static bool write_tga(const std::string& fileName, const t_testimage& image, bool runLengthEncoded)
+{
+    std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    const size_t bytes = pixel_format_bytes(image.format);
+    const char grey = (PIXELFORMAT_GREY8 == image.format);
+    const char imageType = runLengthEncoded ? (grey ? TGA_TYPE_RLE_GREY : TGA_TYPE_RLE_TRUECOLOR) : (grey ? TGA_TYPE_GREY : TGA_TYPE_TRUECOLOR);
+    const char alphaBits = (PIXELFORMAT_BGRA32 == image.format) ? 8 : (PIXELFORMAT_RGB555 == image.format) ? 1 : 0;
+
+    // top-left origin, the rows are stored in the order they are resized
+    const char header[TGA_HEADER_SIZE] = { 0, 0, imageType, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        static_cast<char>(image.width & 0xFF), static_cast<char>(image.width >> 8),
+        static_cast<char>(image.height & 0xFF), static_cast<char>(image.height >> 8),
+        static_cast<char>(bytes * 8), static_cast<char>(TGA_DESCRIPTOR_TOP_DOWN | alphaBits) };
+    file.write(header, sizeof(header));
+
+    if (!runLengthEncoded) {
+        file.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+        return file.good();
+    }
+
+    // runs of two or more equal pixels and raw packets of the others, at most 128 pixels per packet
+    const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+    const unsigned char* pixels = image.pixels.data();
+    auto same = [&](size_t a, size_t b) { return std::equal(pixels + a * bytes, pixels + (a + 1) * bytes, pixels + b * bytes); };
+
+    size_t first = 0;
+    while (first < pixelCount) {
+        size_t run = 1;
+        while (first + run < pixelCount && run < 128 && same(first, first + run)) {
+            run++;
+        }
+        if (run > 1) {
+            file.put(static_cast<char>(0x80 | (run - 1)));
+            file.write(reinterpret_cast<const char*>(pixels + first * bytes), static_cast<std::streamsize>(bytes));
+            first += run;
+            continue;
+        }
+
+        size_t raw = 1;
+        while (first + raw < pixelCount && raw < 128 && !(first + raw + 1 < pixelCount && same(first + raw, first + raw + 1))) {
+            raw++;
+        }
+        file.put(static_cast<char>(raw - 1));
+        file.write(reinterpret_cast<const char*>(pixels + first * bytes), static_cast<std::streamsize>(raw * bytes));
+        first += raw;
+    }
+    return file.good();
+}
+
+static bool read_tga(const std::string& fileName, t_testimage& image)
+{
+    std::ifstream file(fileName, std::ios::in | std::ios::binary);
+    unsigned char header[TGA_HEADER_SIZE];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)))
+        return false;
+
+    image.width = header[12] | (header[13] << 8);
+    image.height = header[14] | (header[15] << 8);
+    switch (header[16]) {
+    case 8:  image.format = PIXELFORMAT_GREY8; break;
+    case 16: image.format = PIXELFORMAT_RGB555; break;
+    case 24: image.format = PIXELFORMAT_BGR24; break;
+    case 32: image.format = PIXELFORMAT_BGRA32; break;
+    default: return false;
+    }
+    file.seekg(header[0], std::ios::cur);
+
+    const size_t bytes = pixel_format_bytes(image.format);
+    const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+    image.pixels.assign(pixelCount * bytes, 0);
+    char* pixels = reinterpret_cast<char*>(image.pixels.data());
+
+    if (header[2] == TGA_TYPE_TRUECOLOR || header[2] == TGA_TYPE_GREY)
+        return static_cast<bool>(file.read(pixels, static_cast<std::streamsize>(image.pixels.size())));
+
+    size_t pixel = 0;
+    while (pixel < pixelCount) {
+        const int packet = file.get();
+        if (packet < 0)
+            return false;
+        const size_t count = static_cast<size_t>(packet & 0x7F) + 1;
+        if (pixel + count > pixelCount)
+            return false;
+
+        if (packet & 0x80) {
+            if (!file.read(pixels + pixel * bytes, static_cast<std::streamsize>(bytes)))
+                return false;
+            for (size_t i = 1; i < count; i++) {
+                std::copy(pixels + pixel * bytes, pixels + (pixel + 1) * bytes, pixels + (pixel + i) * bytes);
+            }
+        }
+        else if (!file.read(pixels + pixel * bytes, static_cast<std::streamsize>(count * bytes))) {
+            return false;
+        }
+        pixel += count;
+    }
+    return true;
+}
+
+
+// ======================================================
+// Reference implementation, double precision and no shortcuts
+
+static int channel_count(pixelFormat format)
+{
+    return (PIXELFORMAT_GREY8 == format) ? 1 : (PIXELFORMAT_BGR24 == format) ? 3 : 4;
+}
+
+static double channel_max(pixelFormat format, int chn)
+{
+    if (PIXELFORMAT_RGB555 == format)
+        return (chn == 3) ? 1.0 : 31.0;
+    return 255.0;
+}
+
+static std::vector<double> channel_limits(pixelFormat format)
+{
+    std::vector<double> limit;
+    for (int chn = 0; chn < channel_count(format); chn++) {
+        limit.push_back(channel_max(format, chn));
+    }
+    return limit;
+}
+
+static t_refimage to_reference(const t_testimage& image)
+{
+    const int channels = channel_count(image.format);
+    const size_t bytes = pixel_format_bytes(image.format);
+    const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+    t_refimage ref = { image.width, image.height, channels, std::vector<double>(pixelCount * channels) };
+
+    for (size_t i = 0; i < pixelCount; i++) {
+        const unsigned char* pixel = &image.pixels[i * bytes];
+        double* value = &ref.values[i * channels];
+        if (PIXELFORMAT_RGB555 == image.format) {
+            const unsigned int packed = pixel[0] | (pixel[1] << 8);
+            value[0] = packed & 0x1F;
+            value[1] = (packed >> 5) & 0x1F;
+            value[2] = (packed >> 10) & 0x1F;
+            value[3] = packed >> 15;
+        }
+        else {
+            for (int chn = 0; chn < channels; chn++) {
+                value[chn] = pixel[chn];
+            }
+        }
+    }
+    return ref;
+}
+
+static t_testimage from_reference(const t_refimage& ref, pixelFormat format)
+{
+    const size_t bytes = pixel_format_bytes(format);
+    const size_t pixelCount = static_cast<size_t>(ref.width) * ref.height;
+    t_testimage image = { ref.width, ref.height, format, std::vector<unsigned char>(pixelCount * bytes) };
+
+    for (size_t i = 0; i < pixelCount; i++) {
+        unsigned int channel[4] = {};
+        for (int chn = 0; chn < ref.channels; chn++) {
+            const double rounded = std::floor(ref.values[i * ref.channels + chn] + 0.5);
+            channel[chn] = static_cast<unsigned int>(std::min(std::max(rounded, 0.0), channel_max(format, chn)));
+        }
+
+        unsigned char* pixel = &image.pixels[i * bytes];
+        if (PIXELFORMAT_RGB555 == format) {
+            const unsigned int packed = channel[0] | (channel[1] << 5) | (channel[2] << 10) | (channel[3] << 15);
+            pixel[0] = static_cast<unsigned char>(packed & 0xFF);
+            pixel[1] = static_cast<unsigned char>(packed >> 8);
+        }
+        else {
+            for (int chn = 0; chn < ref.channels; chn++) {
+                pixel[chn] = static_cast<unsigned char>(channel[chn]);
+            }
+        }
+    }
+    return image;
+}
+
+// the source pixel is floor(j * width / newWidth) in single precision, as in the kernels
+static t_refimage reference_nearest(const t_refimage& source, int newWidth, int newHeight)
+{
+    t_refimage target = { newWidth, newHeight, source.channels, std::vector<double>(static_cast<size_t>(newWidth) * newHeight * source.channels) };
+    const float x_ratio = static_cast<float>(source.width) / static_cast<float>(newWidth);
+    const float y_ratio = static_cast<float>(source.height) / static_cast<float>(newHeight);
+
+    for (int i = 0; i < newHeight; i++) {
+        const int y = static_cast<int>(std::floor(static_cast<float>(i) * y_ratio));
+        for (int j = 0; j < newWidth; j++) {
+            const int x = static_cast<int>(std::floor(static_cast<float>(j) * x_ratio));
+            for (int chn = 0; chn < source.channels; chn++) {
+                target.values[(static_cast<size_t>(i) * newWidth + j) * source.channels + chn] =
+                    source.values[(static_cast<size_t>(y) * source.width + x) * source.channels + chn];
+            }
+        }
+    }
+    return target;
+}
+
+// average of the 2x2 block at (2j, 2i), the last column and row of odd sizes are dropped
+static t_refimage reference_box(const t_refimage& source)
+{
+    const int newWidth = source.width / 2;
+    const int newHeight = source.height / 2;
+    t_refimage target = { newWidth, newHeight, source.channels, std::vector<double>(static_cast<size_t>(newWidth) * newHeight * source.channels) };
+
+    for (int i = 0; i < newHeight; i++) {
+        for (int j = 0; j < newWidth; j++) {
+            for (int chn = 0; chn < source.channels; chn++) {
+                double sum = 0.0;
+                for (int dy = 0; dy < 2; dy++) {
+                    for (int dx = 0; dx < 2; dx++) {
+                        sum += source.values[(static_cast<size_t>(2 * i + dy) * source.width + 2 * j + dx) * source.channels + chn];
+                    }
+                }
+                target.values[(static_cast<size_t>(i) * newWidth + j) * source.channels + chn] = sum / 4.0;
+            }
+        }
+    }
+    return target;
+}
+
+/**
+* Bilinear interpolation as a tent filter of radius 1 around every source pixel centre, the centre of pixel s is
+* at s + 0.5. The output pixel j is taken at its own centre, (j + 0.5) * size / newSize, held between the first
+* and the last source centre.
+*/
+static std::vector<std::vector<std::pair<int, double>>> reference_tent_weights(int size, int newSize)
+{
+    std::vector<std::vector<std::pair<int, double>>> weights(newSize);
+    for (int i = 0; i < newSize; i++) {
+        const double position = std::min(std::max((i + 0.5) * size / newSize, 0.5), size - 0.5);
+        for (int s = 0; s < size; s++) {
+            const double weight = 1.0 - std::fabs(position - (s + 0.5));
+            if (weight > 0.0)
+                weights[i].push_back(std::make_pair(s, weight));
+        }
+    }
+    return weights;
+}
+
+static t_refimage reference_bilinear(const t_refimage& source, int newWidth, int newHeight)
+{
+    t_refimage target = { newWidth, newHeight, source.channels, std::vector<double>(static_cast<size_t>(newWidth) * newHeight * source.channels) };
+    const std::vector<std::vector<std::pair<int, double>>> columns = reference_tent_weights(source.width, newWidth);
+    const std::vector<std::vector<std::pair<int, double>>> rows = reference_tent_weights(source.height, newHeight);
+
+    for (int i = 0; i < newHeight; i++) {
+        for (int j = 0; j < newWidth; j++) {
+            for (int chn = 0; chn < source.channels; chn++) {
+                double sum = 0.0;
+                for (const auto& row : rows[i]) {
+                    for (const auto& column : columns[j]) {
+                        sum += row.second * column.second *
+                               source.values[(static_cast<size_t>(row.first) * source.width + column.first) * source.channels + chn];
+                    }
+                }
+                target.values[(static_cast<size_t>(i) * newWidth + j) * source.channels + chn] = sum;
+            }
+        }
+    }
+    return target;
+}
+
+static double reference_filter(resizeMethod interpolationMethod, double x)
+{
+    const double pi = 3.14159265358979323846;
+    auto sinc = [pi](double v) { return (v == 0.0) ? 1.0 : std::sin(pi * v) / (pi * v); };
+
+    switch (interpolationMethod) {
+    case LANCZOS3_FILTER:
+        return (std::fabs(x) < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+    case BICUBIC_FILTER: {
+        // Keys, a = -0.5
+        const double a = -0.5;
+        const double t = std::fabs(x);
+        if (t < 1.0)
+            return (a + 2.0) * t * t * t - (a + 3.0) * t * t + 1.0;
+        if (t < 2.0)
+            return a * t * t * t - 5.0 * a * t * t + 8.0 * a * t - 4.0 * a;
+        return 0.0;
+    }
+    default:
+        return 0.0;
+    }
+}
+
+// length of the source pixel [s, s + 1) inside the output pixel [begin, end)
+static double reference_coverage(int s, double begin, double end)
+{
+    return std::max(std::min(s + 1.0, end) - std::max(static_cast<double>(s), begin), 0.0);
+}
+
+/**
+* One axis of a separable filter: pixel centres aligned, the filter widened by the ratio when shrinking,
+* the weights inside the image normalized to 1, the nearest pixel when none is
+* The area filter weighs each source pixel by its coverage of the output pixel [i * ratio, (i + 1) * ratio)
+*/
+static std::vector<std::vector<double>> reference_weights(resizeMethod interpolationMethod, int size, int newSize)
+{
+    const double ratio = static_cast<double>(size) / newSize;
+    const double scale = std::max(ratio, 1.0);
+    std::vector<std::vector<double>> weights(newSize, std::vector<double>(size, 0.0));
+
+    for (int i = 0; i < newSize; i++) {
+        const double center = (i + 0.5) * ratio;
+        double total = 0.0;
+        for (int s = 0; s < size; s++) {
+            weights[i][s] = (AREA_FILTER == interpolationMethod) ? reference_coverage(s, i * ratio, (i + 1) * ratio)
+                                                                 : reference_filter(interpolationMethod, (s + 0.5 - center) / scale);
+            total += weights[i][s];
+        }
+        if (total == 0.0) {
+            weights[i][std::min(static_cast<int>(center), size - 1)] = 1.0;
+            total = 1.0;
+        }
+        for (double& weight : weights[i]) {
+            weight /= total;
+        }
+    }
+    return weights;
+}
+
+/**
+* Horizontal pass then vertical pass, the horizontal result is clamped to 0..limit as the kernels store it in
+* the pixel format, which cuts the overshoot of bicubic and Lanczos3 on hard edges before the vertical pass
+*/
+static t_refimage reference_separable(resizeMethod interpolationMethod, const t_refimage& source, int newWidth, int newHeight,
+    const std::vector<double>& limit)
+{
+    const std::vector<std::vector<double>> columns = reference_weights(interpolationMethod, source.width, newWidth);
+    const std::vector<std::vector<double>> rows = reference_weights(interpolationMethod, source.height, newHeight);
+    const int channels = source.channels;
+
+    t_refimage horizontal = { newWidth, source.height, channels, std::vector<double>(static_cast<size_t>(newWidth) * source.height * channels, 0.0) };
+    for (int y = 0; y < source.height; y++) {
+        for (int j = 0; j < newWidth; j++) {
+            for (int s = 0; s < source.width; s++) {
+                if (columns[j][s] == 0.0)
+                    continue;
+                for (int chn = 0; chn < channels; chn++) {
+                    horizontal.values[(static_cast<size_t>(y) * newWidth + j) * channels + chn] +=
+                        columns[j][s] * source.values[(static_cast<size_t>(y) * source.width + s) * channels + chn];
+                }
+            }
+        }
+    }
+    for (size_t k = 0; k < horizontal.values.size(); k++) {
+        horizontal.values[k] = std::min(std::max(horizontal.values[k], 0.0), limit[k % channels]);
+    }
+
+    t_refimage target = { newWidth, newHeight, channels, std::vector<double>(static_cast<size_t>(newWidth) * newHeight * channels, 0.0) };
+    for (int i = 0; i < newHeight; i++) {
+        for (int s = 0; s < source.height; s++) {
+            if (rows[i][s] == 0.0)
+                continue;
+            for (size_t k = 0; k < static_cast<size_t>(newWidth) * channels; k++) {
+                target.values[static_cast<size_t>(i) * newWidth * channels + k] +=
+                    rows[i][s] * horizontal.values[static_cast<size_t>(s) * newWidth * channels + k];
+            }
+        }
+    }
+    return target;
+}
+
+/**
+* Method as TGAProcessing runs it: the box filter only halves, other sizes are interpolated bilinearly
+*/
+static t_refimage reference_resize(const t_refimage& source, int newWidth, int newHeight, resizeMethod interpolationMethod,
+    const std::vector<double>& limit)
+{
+    switch (interpolationMethod) {
+    case NEAREST_NEIGHBOR:
+        return reference_nearest(source, newWidth, newHeight);
+    case BOX_FILTER_2X:
+        if (newWidth == source.width / 2 && newHeight == source.height / 2)
+            return reference_box(source);
+        return reference_bilinear(source, newWidth, newHeight);
+    case BILINEAR_INTERPOL:
+        return reference_bilinear(source, newWidth, newHeight);
+    default:
+        return reference_separable(interpolationMethod, source, newWidth, newHeight, limit);
+    }
+}
+
+static double srgb_to_linear(double value)
+{
+    value /= 255.0;
+    return (value <= 0.04045) ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+}
+
+static double linear_to_srgb(double value)
+{
+    value = std::min(std::max(value, 0.0), 1.0);
+    return 255.0 * ((value <= 0.0031308) ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055);
+}
+
+/**
+* Filter in linear light, the colour premultiplied by alpha, nearest neighbour copies the stored pixels
+*/
+static t_refimage reference_resize_linear(const t_refimage& source, int newWidth, int newHeight, resizeMethod interpolationMethod)
+{
+    if (NEAREST_NEIGHBOR == interpolationMethod)
+        return reference_nearest(source, newWidth, newHeight);
+
+    const bool alpha = (source.channels == 4);
+    const int colours = alpha ? 3 : source.channels;
+    t_refimage linear = source;
+    for (size_t i = 0; i < linear.values.size(); i += linear.channels) {
+        const double coverage = alpha ? linear.values[i + 3] / 255.0 : 1.0;
+        for (int chn = 0; chn < colours; chn++) {
+            linear.values[i + chn] = srgb_to_linear(linear.values[i + chn]) * coverage;
+        }
+        if (alpha) {
+            linear.values[i + 3] = coverage;
+        }
+    }
+
+    t_refimage target = reference_resize(linear, newWidth, newHeight, interpolationMethod, std::vector<double>(linear.channels, 1.0));
+    for (size_t i = 0; i < target.values.size(); i += target.channels) {
+        const double coverage = alpha ? std::min(std::max(target.values[i + 3], 0.0), 1.0) : 1.0;
+        for (int chn = 0; chn < colours; chn++) {
+            target.values[i + chn] = (coverage > 0.0) ? linear_to_srgb(target.values[i + chn] / coverage) : 0.0;
+        }
+        if (alpha) {
+            target.values[i + 3] = coverage * 255.0;
+        }
+    }
+    return target;
+}
+
+
+// ======================================================
+// Comparisons
+
+/**
+* PSNR of the channels scaled to 0..1, infinite when the images are equal
+*/
+static double psnr(const t_testimage& image, const t_testimage& expected)
+{
+    const t_refimage a = to_reference(image);
+    const t_refimage b = to_reference(expected);
+    double squares = 0.0;
+    for (size_t i = 0; i < a.values.size(); i++) {
+        const double difference = (a.values[i] - b.values[i]) / channel_max(image.format, static_cast<int>(i % a.channels));
+        squares += difference * difference;
+    }
+    if (squares == 0.0)
+        return INFINITY;
+    return 10.0 * std::log10(static_cast<double>(a.values.size()) / squares);
+}
+
+static std::string first_difference(const t_testimage& image, const t_testimage& expected)
+{
+    if (image.width != expected.width || image.height != expected.height || image.format != expected.format) {
+        return "size " + std::to_string(image.width) + "x" + std::to_string(image.height) + ", expected " +
+               std::to_string(expected.width) + "x" + std::to_string(expected.height);
+    }
+
+    const size_t bytes = pixel_format_bytes(image.format);
+    for (size_t i = 0; i < image.pixels.size(); i++) {
+        if (image.pixels[i] != expected.pixels[i]) {
+            const size_t pixel = i / bytes;
+            return "pixel (" + std::to_string(pixel % image.width) + ", " + std::to_string(pixel / image.width) + ") byte " +
+                   std::to_string(i % bytes) + ": " + std::to_string(image.pixels[i]) + ", expected " +
+                   std::to_string(expected.pixels[i]);
+        }
+    }
+    return std::string();
+}
+
+/**
+* Lowest PSNR in dB against the reference, infinite for the methods that must match it bit-exactly
+* The kernels round their fixed-point weights and the separable filters their horizontal pass, which keeps
+* plain filtering above 54 dB on the test images. Two cases lose more and get a lower bound: the 1 bit alpha
+* of 16 bit pixels flips where the filtered coverage is about one half, and linear light divides the colour
+* of nearly transparent pixels by their alpha, which magnifies the rounding of the premultiplied values.
+* The area filter covers slivers of source pixels when the ratio is not an integer. Next to transparent pixels
+* they leave an alpha of a step or two of 16 bits, whose colour is all rounding. Those pixels store an alpha of 0
+* either way, but their colour can still differ from the reference by up to 255.
+*/
+static double min_psnr(resizeMethod interpolationMethod, bool halved, bool linearLight, pixelFormat format)
+{
+    if (NEAREST_NEIGHBOR == interpolationMethod)
+        return INFINITY;
+    if (BOX_FILTER_2X == interpolationMethod && halved && !linearLight)
+        return INFINITY;
+    if (AREA_FILTER == interpolationMethod && linearLight && PIXELFORMAT_BGRA32 == format)
+        return 30.0;
+    if (PIXELFORMAT_RGB555 == format || linearLight)
+        return 35.0;
+    return 50.0;
+}
+
+static void check_against_reference(const std::string& name, const t_testimage& image, const t_testimage& expected,
+    double minimum)
+{
+    if (image.width != expected.width || image.height != expected.height) {
+        report(name, false, first_difference(image, expected));
+        return;
+    }
+
+    if (std::isinf(minimum)) {
+        const std::string difference = first_difference(image, expected);
+        report(name, difference.empty(), difference);
+        return;
+    }
+
+    const double measured = psnr(image, expected);
+    std::ostringstream detail;
+    if (measured < minimum) {
+        detail << std::fixed << std::setprecision(2) << measured << " dB, at least " << minimum << " dB expected";
+    }
+    report(name, measured >= minimum, detail.str());
+}
+
+
+// ======================================================
+// Golden tests
+
+static t_testimage resize_buffer(TGAProcessing& tgaImageProcessing, const t_testimage& source, int newWidth, int newHeight,
+    resizeMethod interpolationMethod)
+{
+    const size_t bytes = pixel_format_bytes(source.format);
+    t_testimage target = { newWidth, newHeight, source.format, std::vector<unsigned char>(static_cast<size_t>(newWidth) * newHeight * bytes) };
+
+    const t_imagebuffer sourceBuffer = { reinterpret_cast<char*>(const_cast<unsigned char*>(source.pixels.data())), source.width,
+                                         source.height, static_cast<size_t>(source.width) * bytes, source.format };
+    const t_imagebuffer targetBuffer = { reinterpret_cast<char*>(target.pixels.data()), newWidth, newHeight,
+                                         static_cast<size_t>(newWidth) * bytes, target.format };
+    if (FILE_OK != tgaImageProcessing.ResizeImageBuffer(sourceBuffer, targetBuffer, interpolationMethod)) {
+        target.pixels.clear();
+    }
+    return target;
+}
+
+/**
+* Every method and pixel format against the reference, at half size, at an arbitrary smaller size and enlarged
+*/
+static void run_reference_tests(const t_testsettings& settings)
+{
+    const int sizes[][2] = { { TEST_WIDTH / 2, TEST_HEIGHT / 2 }, { 97, 61 }, { 413, 290 } };
+    TGAProcessing tgaImageProcessing;
+
+    for (pixelFormat format : allFormats) {
+        const t_testimage source = make_synthetic(format, TEST_WIDTH, TEST_HEIGHT, TEST_SEED);
+        const t_refimage sourceRef = to_reference(source);
+
+        // halving an even sized image, bilinear blends each 2x2 block where nearest neighbour picks one of its
+        // pixels, so most output pixels differ. When bilinear sampled the pixel corners none did.
+        const std::string distinctName = std::string("reference/bilinear-vs-nearest/") + format_name(format);
+        if (selected(settings, distinctName)) {
+            const t_testimage even = make_synthetic(format, TEST_WIDTH - 1, TEST_HEIGHT - 1, TEST_SEED);
+            tgaImageProcessing.SetLinearLight(false);
+            const t_testimage bilinear = resize_buffer(tgaImageProcessing, even, even.width / 2, even.height / 2, BILINEAR_INTERPOL);
+            const t_testimage nearest = resize_buffer(tgaImageProcessing, even, even.width / 2, even.height / 2, NEAREST_NEIGHBOR);
+            const size_t bytes = pixel_format_bytes(format);
+            const size_t pixels = static_cast<size_t>(even.width / 2) * (even.height / 2);
+            size_t differing = 0;
+            if (bilinear.pixels.size() == pixels * bytes && nearest.pixels.size() == pixels * bytes) {
+                for (size_t offset = 0; offset < pixels * bytes; offset += bytes) {
+                    if (!std::equal(bilinear.pixels.begin() + offset, bilinear.pixels.begin() + offset + bytes, nearest.pixels.begin() + offset))
+                        differing++;
+                }
+            }
+            std::ostringstream detail;
+            if (2 * differing < pixels) {
+                detail << differing << " of " << pixels << " pixels differ from nearest neighbour, at least half expected";
+            }
+            report(distinctName, 2 * differing >= pixels, detail.str());
+        }
+
+        for (int linear = 0; linear < 2; linear++) {
+            if (linear && !linear_light_supported(format))
+                continue;
+            tgaImageProcessing.SetLinearLight(linear != 0);
+
+            for (resizeMethod interpolationMethod : allMethods) {
+                for (const auto& size : sizes) {
+                    const std::string name = std::string("reference/") + method_name(interpolationMethod) + (linear ? "-linear/" : "/") +
+                                             format_name(format) + "/" + std::to_string(size[0]) + "x" + std::to_string(size[1]);
+                    if (!selected(settings, name))
+                        continue;
+
+                    const t_testimage resized = resize_buffer(tgaImageProcessing, source, size[0], size[1], interpolationMethod);
+                    const t_refimage expected = linear ? reference_resize_linear(sourceRef, size[0], size[1], interpolationMethod)
+                                                       : reference_resize(sourceRef, size[0], size[1], interpolationMethod, channel_limits(format));
+                    const bool halved = (size[0] == TEST_WIDTH / 2 && size[1] == TEST_HEIGHT / 2);
+                    check_against_reference(name, resized, from_reference(expected, format),
+                        min_psnr(interpolationMethod, halved, linear != 0, format));
+                }
+            }
+        }
+    }
+}
+
+/**
+* Every method on a real image, halved
+*/
+static void run_image_tests(const t_testsettings& settings)
+{
+    t_testimage source;
+    if (!read_tga(settings.imageFileName, source)) {
+        report("image/" + settings.imageFileName, false, "cannot be read");
+        return;
+    }
+
+    TGAProcessing tgaImageProcessing;
+    const t_refimage sourceRef = to_reference(source);
+    const int newWidth = source.width / 2;
+    const int newHeight = source.height / 2;
+
+    for (resizeMethod interpolationMethod : allMethods) {
+        const std::string name = std::string("image/") + method_name(interpolationMethod) + "/" + format_name(source.format);
+        if (!selected(settings, name))
+            continue;
+
+        const t_testimage resized = resize_buffer(tgaImageProcessing, source, newWidth, newHeight, interpolationMethod);
+        const t_refimage expected = reference_resize(sourceRef, newWidth, newHeight, interpolationMethod, channel_limits(source.format));
+        check_against_reference(name, resized, from_reference(expected, source.format),
+            min_psnr(interpolationMethod, true, false, source.format));
+    }
+}
+
+/**
+* One way of getting from a file to a resized file, must give the bytes of ResizeImageBuffer
+*/
+typedef struct
+{
+    const char* name;
+    bool        rleInput;
+    bool        rleOutput;
+    size_t      threadCount;
+    int         mode;           // 0 LoadImage/ResizeImage/SaveImage, 1 ResizeImageToFile, 2 streaming, 3 region
+    bool        memoryMapping;
+    bool        parallelRead;
+} t_filepath;
+
+static const t_filepath filePaths[] = {
+    { "mmap",       false, false, 1,            0, true,  false },
+    { "fstream",    false, false, 1,            0, false, false },
+    { "pread",      false, false, 1,            0, true,  true  },
+    { "tofile",     false, false, 1,            1, true,  false },
+    { "stream",     false, false, 1,            2, true,  false },
+    { "region",     false, false, 1,            3, true,  false },
+    { "rle",        true,  true,  1,            0, true,  false },
+    { "rle-stream", true,  true,  1,            2, true,  false },
+    { "threads",    false, false, TEST_THREADS, 0, true,  false },
+};
+
+/**
+* Every file path against ResizeImageBuffer, on the synthetic image and on images with a side of one or two
+* pixels. Such a side stays one pixel when halved, so the box filter must not be used for them.
+*/
+static void run_file_path_tests(const t_testsettings& settings)
+{
+    const float scaleFactors[] = { 2.0f, 3.0f };
+    const int sizes[][2] = { { TEST_WIDTH, TEST_HEIGHT }, { 1, 16 }, { 16, 1 }, { 1, 1 }, { 2, 1 } };
+    // region of the synthetic image, as displayed, the rows are stored top-down
+    const t_region region = { 37, 21, 150, 101 };
+
+    for (pixelFormat format : allFormats) {
+        for (const auto& size : sizes) {
+            const t_testimage source = make_synthetic(format, size[0], size[1], TEST_SEED + 1);
+            const size_t bytes = pixel_format_bytes(format);
+            const bool fullSize = (size[0] == TEST_WIDTH && size[1] == TEST_HEIGHT);
+
+            t_testimage regionSource = { region.width, region.height, format, std::vector<unsigned char>() };
+            for (int y = region.y; fullSize && y < region.y + region.height; y++) {
+                const unsigned char* row = &source.pixels[(static_cast<size_t>(y) * TEST_WIDTH + region.x) * bytes];
+                regionSource.pixels.insert(regionSource.pixels.end(), row, row + region.width * bytes);
+            }
+
+            for (const t_filepath& path : filePaths) {
+                // the region lies inside the synthetic image only
+                if (path.mode == 3 && !fullSize)
+                    continue;
+                if (!write_tga(TEST_INPUT_NAME, source, path.rleInput)) {
+                    report(std::string("files/") + path.name, false, "cannot write " TEST_INPUT_NAME);
+                    return;
+                }
+
+                for (int linear = 0; linear < 2; linear++) {
+                    if (linear && !linear_light_supported(format))
+                        continue;
+
+                    for (resizeMethod interpolationMethod : allMethods) {
+                        for (float scaleFactor : scaleFactors) {
+                            const std::string name = std::string("files/") + path.name + "/" + method_name(interpolationMethod) +
+                                                     (linear ? "-linear/" : "/") + format_name(format) + "/" +
+                                                     std::to_string(size[0]) + "x" + std::to_string(size[1]) + "/scale" +
+                                                     std::to_string(static_cast<int>(scaleFactor));
+                            if (!selected(settings, name))
+                                continue;
+
+                            TGAProcessing tgaImageProcessing(std::make_shared<ThreadPool>(path.threadCount));
+                            tgaImageProcessing.SetMemoryMapping(path.memoryMapping);
+                            tgaImageProcessing.SetParallelRead(path.parallelRead);
+                            tgaImageProcessing.SetRleOutput(path.rleOutput);
+                            tgaImageProcessing.SetLinearLight(linear != 0);
+
+                            const t_testimage& original = (path.mode == 3) ? regionSource : source;
+                            int newWidth, newHeight;
+                            TGAProcessing::ResizedSize(original.width, original.height, scaleFactor, newWidth, newHeight);
+                            // the box filter only gives exactly half of the size, bilinear stands in for any other target
+                            const bool halved = (newWidth == original.width / 2 && newHeight == original.height / 2);
+                            const resizeMethod bufferMethod = (BOX_FILTER_2X == interpolationMethod && !halved) ?
+                                                              BILINEAR_INTERPOL : interpolationMethod;
+                            const t_testimage expected = resize_buffer(tgaImageProcessing, original, newWidth, newHeight, bufferMethod);
+
+                            fileStatus status = FILE_OK;
+                            switch (path.mode) {
+                            case 0:
+                                status = tgaImageProcessing.LoadImage(TEST_INPUT_NAME);
+                                if (FILE_OK == status) {
+                                    tgaImageProcessing.ResizeImage(scaleFactor, interpolationMethod);
+                                    status = tgaImageProcessing.SaveImage(TEST_OUTPUT_NAME);
+                                }
+                                break;
+                            case 1:
+                                status = tgaImageProcessing.LoadImage(TEST_INPUT_NAME);
+                                if (FILE_OK == status) {
+                                    status = tgaImageProcessing.ResizeImageToFile(TEST_OUTPUT_NAME, scaleFactor, interpolationMethod);
+                                }
+                                break;
+                            case 2:
+                                status = tgaImageProcessing.ResizeImageStreaming(TEST_INPUT_NAME, TEST_OUTPUT_NAME, scaleFactor,
+                                    interpolationMethod, TEST_BAND_ROWS);
+                                break;
+                            default:
+                                status = tgaImageProcessing.LoadRegion(TEST_INPUT_NAME, region);
+                                if (FILE_OK == status) {
+                                    tgaImageProcessing.ResizeImage(scaleFactor, interpolationMethod);
+                                    status = tgaImageProcessing.SaveImage(TEST_OUTPUT_NAME);
+                                }
+                                break;
+                            }
+
+                            t_testimage resized;
+                            if (FILE_OK != status) {
+                                report(name, false, "fileStatus " + std::to_string(static_cast<int>(status)));
+                            }
+                            else if (!read_tga(TEST_OUTPUT_NAME, resized)) {
+                                report(name, false, "output cannot be read");
+                            }
+                            else {
+                                const std::string difference = first_difference(resized, expected);
+                                report(name, difference.empty(), difference);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::remove(TEST_INPUT_NAME);
+    std::remove(TEST_OUTPUT_NAME);
+}
+
+
+// ======================================================
+// Performance regression
+
+typedef struct
+{
+    const char*     name;
+    pixelFormat     format;
+    resizeMethod    method;
+    bool            linearLight;
+} t_perfcase;
+
+static const t_perfcase perfCases[] = {
+    { "box/32bit",             PIXELFORMAT_BGRA32, BOX_FILTER_2X,     false },
+    { "box/24bit",             PIXELFORMAT_BGR24,  BOX_FILTER_2X,     false },
+    { "box/8bit",              PIXELFORMAT_GREY8,  BOX_FILTER_2X,     false },
+    { "nearest/32bit",         PIXELFORMAT_BGRA32, NEAREST_NEIGHBOR,  false },
+    { "bilinear/32bit",        PIXELFORMAT_BGRA32, BILINEAR_INTERPOL, false },
+    { "bilinear/16bit",        PIXELFORMAT_RGB555, BILINEAR_INTERPOL, false },
+    { "area/32bit",            PIXELFORMAT_BGRA32, AREA_FILTER,       false },
+    { "bicubic/24bit",         PIXELFORMAT_BGR24,  BICUBIC_FILTER,    false },
+    { "lanczos3/32bit",        PIXELFORMAT_BGRA32, LANCZOS3_FILTER,   false },
+    { "box-linear/32bit",      PIXELFORMAT_BGRA32, BOX_FILTER_2X,     true  },
+    { "lanczos3-linear/24bit", PIXELFORMAT_BGR24,  LANCZOS3_FILTER,   true  },
+};
+
+/**
+* ns per source pixel of ResizeImageBuffer halving a PERF_WIDTH x PERF_HEIGHT image on one thread,
+* the best of PERF_REPETITIONS runs of at least PERF_MIN_TIME
+*/
+static double time_case(const t_perfcase& perfCase)
+{
+    TGAProcessing tgaImageProcessing(std::make_shared<ThreadPool>(1));
+    tgaImageProcessing.SetLinearLight(perfCase.linearLight);
+    const t_testimage source = make_synthetic(perfCase.format, PERF_WIDTH, PERF_HEIGHT, TEST_SEED);
+    const size_t bytes = pixel_format_bytes(perfCase.format);
+    std::vector<char> targetPixels(static_cast<size_t>(PERF_WIDTH / 2) * (PERF_HEIGHT / 2) * bytes);
+
+    const t_imagebuffer sourceBuffer = { reinterpret_cast<char*>(const_cast<unsigned char*>(source.pixels.data())), PERF_WIDTH,
+                                         PERF_HEIGHT, PERF_WIDTH * bytes, perfCase.format };
+    const t_imagebuffer targetBuffer = { targetPixels.data(), PERF_WIDTH / 2, PERF_HEIGHT / 2, (PERF_WIDTH / 2) * bytes, perfCase.format };
+
+    tgaImageProcessing.ResizeImageBuffer(sourceBuffer, targetBuffer, perfCase.method);
+
+    double best = 1e30;
+    for (int rep = 0; rep < PERF_REPETITIONS; rep++) {
+        size_t iterations = 0;
+        const auto start = std::chrono::steady_clock::now();
+        double seconds = 0.0;
+        do {
+            tgaImageProcessing.ResizeImageBuffer(sourceBuffer, targetBuffer, perfCase.method);
+            iterations++;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (seconds < PERF_MIN_TIME);
+
+        best = std::min(best, seconds * 1e9 / (static_cast<double>(iterations) * PERF_WIDTH * PERF_HEIGHT));
+    }
+    return best;
+}
+
+static bool read_baseline(const std::string& fileName, std::map<std::string, double>& baseline)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string name;
+        double nsPerPixel;
+        if (fields >> name >> nsPerPixel) {
+            baseline[name] = nsPerPixel;
+        }
+    }
+    return true;
+}
+
+static int run_perf_tests(const t_testsettings& settings)
+{
+    std::map<std::string, double> baseline;
+    const bool writing = !settings.baselineOutputName.empty();
+    if (!writing && !read_baseline(settings.perfFileName, baseline)) {
+        std::cout << "Cannot read the baseline " << settings.perfFileName << std::endl;
+        return 1;
+    }
+
+    std::ostringstream output;
+    output << "# ns per source pixel of ResizeImageBuffer halving a " << PERF_WIDTH << "x" << PERF_HEIGHT
+           << " image on one thread, best of " << PERF_REPETITIONS << " runs" << std::endl;
+    output << "# written by halfsize_tests --write-baseline, only valid for the machine it ran on" << std::endl;
+
+    std::cout << std::left << std::setw(28) << "Kernel" << std::right << std::setw(14) << "baseline ns" << std::setw(14)
+              << "measured ns" << std::setw(10) << "ratio" << std::endl;
+    std::cout << std::string(66, '-') << std::endl;
+
+    int slower = 0;
+    for (const t_perfcase& perfCase : perfCases) {
+        if (!selected(settings, perfCase.name))
+            continue;
+
+        double measured = time_case(perfCase);
+        const auto entry = baseline.find(perfCase.name);
+        for (int retry = 0; retry < PERF_RETRIES && entry != baseline.end() && measured > entry->second * (1.0 + settings.margin); retry++) {
+            measured = std::min(measured, time_case(perfCase));
+        }
+        output << perfCase.name << " " << std::fixed << std::setprecision(3) << measured << std::endl;
+
+        std::cout << std::left << std::setw(28) << perfCase.name << std::right << std::fixed << std::setprecision(3);
+        if (entry == baseline.end()) {
+            std::cout << std::setw(14) << "-" << std::setw(14) << measured << std::endl;
+            continue;
+        }
+
+        const double ratio = measured / entry->second;
+        const bool regressed = ratio > 1.0 + settings.margin;
+        std::cout << std::setw(14) << entry->second << std::setw(14) << measured << std::setw(10) << std::setprecision(2)
+                  << ratio << (regressed ? "  SLOWER" : "") << std::endl;
+        if (regressed) {
+            slower++;
+        }
+    }
+
+    if (writing) {
+        std::ofstream file(settings.baselineOutputName, std::ios::out | std::ios::trunc);
+        file << output.str();
+        if (!file.good()) {
+            std::cout << "Cannot write " << settings.baselineOutputName << std::endl;
+            return 1;
+        }
+        std::cout << "Baseline written to " << settings.baselineOutputName << std::endl;
+        return 0;
+    }
+
+    std::cout << slower << " kernels slower than their baseline by more than " << std::setprecision(0)
+              << settings.margin * 100.0 << "%" << std::endl;
+    return (slower == 0) ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+    t_testsettings settings;
+    settings.margin = PERF_DEFAULT_MARGIN;
+
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        const std::string arg(argv[argIdx]);
+        if (arg == "--filter" && argIdx + 1 < argc) {
+            settings.filter = argv[++argIdx];
+        }
+        else if (arg == "--image" && argIdx + 1 < argc) {
+            settings.imageFileName = argv[++argIdx];
+        }
+        else if (arg == "--perf" && argIdx + 1 < argc) {
+            settings.perfFileName = argv[++argIdx];
+        }
+        else if (arg == "--margin" && argIdx + 1 < argc) {
+            settings.margin = std::strtod(argv[++argIdx], nullptr);
+        }
+        else if (arg == "--write-baseline" && argIdx + 1 < argc) {
+            settings.baselineOutputName = argv[++argIdx];
+        }
+        else {
+            std::cout << "Unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    if (!settings.perfFileName.empty() || !settings.baselineOutputName.empty())
+        return run_perf_tests(settings);
+
+    run_reference_tests(settings);
+    if (!settings.imageFileName.empty()) {
+        run_image_tests(settings);
+    }
+    run_file_path_tests(settings);
+
+    std::cout << checks - failures << "/" << checks << " checks passed" << std::endl;
+    return (failures == 0) ? 0 : 1;
+}
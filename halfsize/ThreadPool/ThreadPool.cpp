@@ -0,0 +1,174 @@
+#include "ThreadPool.h"
+
+
+// Pool and queue of the worker running on this thread
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : pendingTasks(0), stopping(false)
+{
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<t_taskqueue>());
+        queues.back()->head = 0;
+    }
+
+    // the thread calling ParallelFor is one of the workers
+    for (size_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const
+{
+    return workers.size() + 1;
+}
+
+size_t ThreadPool::OwnQueue() const
+{
+    return (currentPool == this) ? currentQueue : 0;
+}
+
+void ThreadPool::Push(t_band band, int bandSize, int count)
+{
+    const int bandCount = (count - band.begin + bandSize - 1) / bandSize;
+
+    t_taskqueue& queue = *queues[OwnQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        // stolen bands are dropped from the front and room is made for all the new ones at once, so the
+        // queue stops growing once it has held the largest ParallelFor
+        queue.bands.erase(queue.bands.begin(), queue.bands.begin() + queue.head);
+        queue.head = 0;
+        queue.bands.reserve(queue.bands.size() + bandCount);
+
+        for (; band.begin < count; band.begin += bandSize) {
+            band.end = (band.begin + bandSize < count) ? band.begin + bandSize : count;
+            queue.bands.push_back(band);
+        }
+    }
+    pendingTasks.fetch_add(bandCount);
+
+    // taking the lock orders the increment before any waiter's predicate check
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeCondition.notify_all();
+}
+
+bool ThreadPool::RunOneTask()
+{
+    if (pendingTasks.load() == 0)
+        return false;
+
+    const size_t ownQueue = OwnQueue();
+    t_band band;
+    bool found = false;
+
+    // own queue newest first (still hot in cache), then steal the oldest task of the others
+    for (size_t i = 0; i < queues.size() && !found; i++) {
+        const size_t queueIndex = (ownQueue + i) % queues.size();
+        t_taskqueue& queue = *queues[queueIndex];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.head == queue.bands.size())
+            continue;
+
+        if (queueIndex == ownQueue) {
+            band = queue.bands.back();
+            queue.bands.pop_back();
+        }
+        else {
+            band = queue.bands[queue.head++];
+        }
+        // an empty queue starts again from the front, the capacity is kept
+        if (queue.head == queue.bands.size()) {
+            queue.bands.clear();
+            queue.head = 0;
+        }
+        found = true;
+    }
+
+    if (!found)
+        return false;
+
+    pendingTasks.fetch_sub(1);
+    band.function(band.task, band.begin, band.end);
+    if (band.bandsLeft->fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCondition.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::RunBands(int count, int bandSize, t_bandfunction function, const void* task)
+{
+    if (count <= 0)
+        return;
+    if (bandSize < 1)
+        bandSize = 1;
+
+    const int bandCount = (count + bandSize - 1) / bandSize;
+
+    if (workers.empty() || bandCount == 1) {
+        function(task, 0, count);
+        return;
+    }
+
+    std::atomic<int> bandsLeft(bandCount);
+
+    // the first band is run by the caller straight away, the others are stolen in order from the front
+    // of the queue while the caller works back from the last one
+    const t_band firstQueued = { function, task, &bandsLeft, bandSize, 0 };
+    Push(firstQueued, bandSize, count);
+
+    function(task, 0, bandSize);
+    bandsLeft.fetch_sub(1);
+
+    while (bandsLeft.load() > 0) {
+        if (RunOneTask())
+            continue;
+
+        // remaining bands are running on other threads
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [&]() { return bandsLeft.load() == 0 || pendingTasks.load() > 0; });
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t queueIndex)
+{
+    currentPool = this;
+    currentQueue = queueIndex;
+
+    for (;;) {
+        if (RunOneTask())
+            continue;
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this]() { return stopping || pendingTasks.load() > 0; });
+        if (stopping)
+            return;
+    }
+}
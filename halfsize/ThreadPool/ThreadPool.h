@@ -0,0 +1,98 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+Persistent work-stealing pool of worker threads
+Every worker owns a task queue: it runs its own tasks newest first and steals the oldest tasks of the
+other queues when it runs out. Tasks submitted from outside the pool go to a shared queue.
+A thread waiting on a ParallelFor keeps running tasks, so ParallelFor can be nested (e.g. the row
+bands of one image inside a batch of images) and idle threads pick up the bands of large images.
+Queued bands only point to the task and the queues keep their capacity, so a ParallelFor does not allocate
+once the queues have grown to the largest number of bands.
+*/
+class ThreadPool
+{
+public:
+    /**
+    * @param threadCount - number of threads working on a ParallelFor, including the caller (0 = all cores)
+    */
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+    * Splits [0, count) into bands of bandSize and runs task(begin, end) on each of them
+    * Blocks until all bands are done, the calling thread runs tasks while it waits
+    *
+    * @param count    - number of items, e.g. output rows
+    * @param bandSize - number of items per task call
+    * @param task     - function called with a [begin, end) band, must be callable from several threads at once
+    */
+    template <typename Task>
+    void ParallelFor(int count, int bandSize, const Task& task)
+    {
+        RunBands(count, bandSize, &CallBand<Task>, &task);
+    }
+
+    size_t GetThreadCount() const;
+
+private:
+    typedef void (*t_bandfunction)(const void* task, int begin, int end);
+
+    /**
+    One band of a ParallelFor, the task lives on the stack of the thread that called it
+    */
+    typedef struct
+    {
+        t_bandfunction      function;
+        const void*         task;
+        std::atomic<int>*   bandsLeft;
+        int                 begin;
+        int                 end;
+    } t_band;
+
+    /**
+    Bands [head, bands.size()) are queued, the owner pops from the back and thieves take from head
+    */
+    typedef struct
+    {
+        std::vector<t_band> bands;
+        size_t              head;
+        std::mutex          mutex;
+    } t_taskqueue;
+
+    std::vector<std::thread>                    workers;
+    // queue 0 is shared by threads outside the pool, queue i belongs to worker i
+    std::vector<std::unique_ptr<t_taskqueue>>   queues;
+
+    std::atomic<int>                            pendingTasks;
+    std::mutex                                  wakeMutex;
+    std::condition_variable                     wakeCondition;
+    bool                                        stopping;
+
+    template <typename Task>
+    static void CallBand(const void* task, int begin, int end)
+    {
+        (*static_cast<const Task*>(task))(begin, end);
+    }
+
+    void RunBands(int count, int bandSize, t_bandfunction function, const void* task);
+    void WorkerLoop(size_t queueIndex);
+    // queues the bands of bandSize items from band.begin up to count, band.end is set for each
+    void Push(t_band band, int bandSize, int count);
+    bool RunOneTask();
+    size_t OwnQueue() const;
+};
+
+
+#endif	//THREADPOOL_H